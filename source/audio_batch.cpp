@@ -0,0 +1,207 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "audio_batch.hpp"
+#include <chrono>
+#include <map>
+#include <vector>
+#include "encoder.hpp"
+#include "plugin.hpp"
+
+#define ST_CONFIG_AUDIOBATCHING "Audio.Batching"
+
+// Longest time the worker waits for the remaining tracks of a timestamp before encoding what it has.
+#define BATCH_TIMEOUT std::chrono::milliseconds(10)
+
+static std::mutex                                                batches_lock;
+static std::map<audio_t*, std::weak_ptr<obsffmpeg::audio_batch>> batches;
+
+obsffmpeg::audio_batch::audio_batch() : _abort(false)
+{
+	_worker = std::thread(&audio_batch::worker, this);
+}
+
+obsffmpeg::audio_batch::~audio_batch()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_abort = true;
+	}
+	_wake.notify_all();
+	if (_worker.joinable())
+		_worker.join();
+}
+
+std::shared_ptr<obsffmpeg::audio_batch> obsffmpeg::audio_batch::get(audio_t* audio)
+{
+	std::lock_guard<std::mutex> lock(batches_lock);
+
+	auto found = batches.find(audio);
+	if (found != batches.end()) {
+		if (auto batch = found->second.lock())
+			return batch;
+	}
+
+	auto batch     = std::make_shared<audio_batch>();
+	batches[audio] = batch;
+	return batch;
+}
+
+void obsffmpeg::audio_batch::get_defaults(obs_data_t* config)
+{
+	obs_data_set_default_bool(config, ST_CONFIG_AUDIOBATCHING, false);
+}
+
+bool obsffmpeg::audio_batch::is_enabled(obs_data_t* config)
+{
+	return config && obs_data_get_bool(config, ST_CONFIG_AUDIOBATCHING);
+}
+
+void obsffmpeg::audio_batch::join(encoder* instance)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_members.push_back({instance, {}, 0, 0});
+}
+
+void obsffmpeg::audio_batch::leave(encoder* instance)
+{
+	std::queue<std::shared_ptr<AVFrame>> remaining;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		for (auto& m : _members) {
+			if (m.instance == instance)
+				remaining.swap(m.frames);
+		}
+		_members.remove_if([instance](const member& m) { return m.instance == instance; });
+	}
+
+	// Wait for a batch that may still contain the instance, then encode what is left in order.
+	{
+		std::lock_guard<std::mutex> lock(_process_lock);
+		while (remaining.size() > 0) {
+			try {
+				instance->encode_batched(remaining.front());
+			} catch (const std::exception& ex) {
+				PLOG_ERROR("Unexpected exception while encoding batched audio: %s.", ex.what());
+			}
+			remaining.pop();
+		}
+	}
+}
+
+std::shared_ptr<AVFrame> obsffmpeg::audio_batch::acquire_frame()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (_free_frames.size() > 0) {
+			auto frame = _free_frames.top();
+			_free_frames.pop();
+			return frame;
+		}
+	}
+
+	return std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
+		av_frame_unref(frame);
+		av_frame_free(&frame);
+	});
+}
+
+void obsffmpeg::audio_batch::submit(encoder* instance, std::shared_ptr<AVFrame> frame)
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		for (auto& m : _members) {
+			if (m.instance == instance) {
+				m.frames.push(frame);
+				m.submitted++;
+				break;
+			}
+		}
+	}
+	_wake.notify_one();
+}
+
+void obsffmpeg::audio_batch::wait_for_previous(encoder* instance, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	_encoded.wait_for(lock, timeout, [this, instance]() {
+		for (auto& m : _members) {
+			if (m.instance == instance)
+				return (m.encoded + 1) >= m.submitted;
+		}
+		return true;
+	});
+}
+
+bool obsffmpeg::audio_batch::is_complete()
+{
+	if (_members.size() == 0)
+		return false;
+
+	for (auto& m : _members) {
+		if (m.frames.size() == 0)
+			return false;
+	}
+	return true;
+}
+
+void obsffmpeg::audio_batch::worker()
+{
+	std::vector<std::pair<encoder*, std::shared_ptr<AVFrame>>> batch;
+
+	std::unique_lock<std::mutex> lock(_lock);
+	while (!_abort) {
+		_wake.wait_for(lock, BATCH_TIMEOUT, [this]() { return _abort || is_complete(); });
+		if (_abort)
+			break;
+
+		batch.clear();
+		for (auto& m : _members) {
+			if (m.frames.size() > 0) {
+				batch.emplace_back(m.instance, m.frames.front());
+				m.frames.pop();
+			}
+		}
+		if (batch.size() == 0)
+			continue;
+
+		std::unique_lock<std::mutex> process_lock(_process_lock);
+		lock.unlock();
+		for (auto& kv : batch) {
+			try {
+				kv.first->encode_batched(kv.second);
+			} catch (const std::exception& ex) {
+				PLOG_ERROR("Unexpected exception while encoding batched audio: %s.", ex.what());
+			}
+		}
+		lock.lock();
+		process_lock.unlock();
+
+		for (auto& kv : batch) {
+			_free_frames.push(kv.second);
+			for (auto& m : _members) {
+				if (m.instance == kv.first)
+					m.encoded++;
+			}
+		}
+		_encoded.notify_all();
+	}
+}
@@ -0,0 +1,94 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stack>
+#include <thread>
+
+extern "C" {
+#include <obs.h>
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/frame.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	class encoder;
+
+	// Encodes the frames of every audio encoder attached to the same audio output on one shared worker, so
+	// that multi-track recordings wake up a single thread per timestamp instead of one per track.
+	class audio_batch {
+		struct member {
+			encoder*                             instance;
+			std::queue<std::shared_ptr<AVFrame>> frames;
+			size_t                               submitted;
+			size_t                               encoded;
+		};
+
+		std::mutex                           _lock;
+		std::condition_variable              _wake;
+		std::condition_variable              _encoded;
+		std::list<member>                    _members;
+		std::stack<std::shared_ptr<AVFrame>> _free_frames;
+
+		// Held while a batch is encoded, so that members can't leave in the middle of it.
+		std::mutex _process_lock;
+
+		std::thread _worker;
+		bool        _abort;
+
+		bool is_complete();
+
+		void worker();
+
+		public:
+		audio_batch();
+		~audio_batch();
+
+		// Shared batch for all encoders of this audio output.
+		static std::shared_ptr<audio_batch> get(audio_t* audio);
+
+		static void get_defaults(obs_data_t* config);
+
+		static bool is_enabled(obs_data_t* config);
+
+		void join(encoder* instance);
+
+		// Returns once the worker no longer uses the instance. Frames left in its queue are encoded here.
+		void leave(encoder* instance);
+
+		// Frames are pooled across all members.
+		std::shared_ptr<AVFrame> acquire_frame();
+
+		void submit(encoder* instance, std::shared_ptr<AVFrame> frame);
+
+		// Wait until every frame of the instance except the last submitted one was encoded, so that packets
+		// are ready one call after their frame and never pile up.
+		void wait_for_previous(encoder* instance, std::chrono::milliseconds timeout);
+	};
+} // namespace obsffmpeg
@@ -0,0 +1,213 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "benchmark.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "encoder.hpp"
+#include "ffmpeg/tools.hpp"
+#include "hwapi/system.hpp"
+#include "plugin.hpp"
+#include "utility.hpp"
+
+extern "C" {
+#include <obs.h>
+}
+
+struct benchmark_record {
+	std::string              stage;
+	std::string              subject;
+	std::chrono::nanoseconds time;
+};
+
+static std::mutex                    records_lock;
+static std::vector<benchmark_record> records;
+
+obsffmpeg::benchmark::scope::scope(const char* stage, std::string subject)
+    : _stage(stage), _subject(subject), _start(std::chrono::high_resolution_clock::now())
+{}
+
+obsffmpeg::benchmark::scope::~scope()
+{
+	record(_stage, _subject, std::chrono::high_resolution_clock::now() - _start);
+}
+
+void obsffmpeg::benchmark::record(const char* stage, std::string subject, std::chrono::nanoseconds time)
+{
+	std::unique_lock<std::mutex> ulock(records_lock);
+	records.push_back({stage, subject, time});
+}
+
+static double to_ms(std::chrono::nanoseconds time)
+{
+	return static_cast<double>(time.count()) / 1000000.0;
+}
+
+void obsffmpeg::benchmark::report(std::string prefix)
+{
+	std::vector<benchmark_record> selected;
+	{
+		std::unique_lock<std::mutex> ulock(records_lock);
+		auto last = std::stable_partition(records.begin(), records.end(),
+		                                  [&prefix](const benchmark_record& rec) {
+			                                  return rec.stage.compare(0, prefix.size(), prefix) != 0;
+		                                  });
+		selected.assign(last, records.end());
+		records.erase(last, records.end());
+	}
+	if (selected.size() == 0)
+		return;
+
+	std::sort(selected.begin(), selected.end(),
+	          [](const benchmark_record& a, const benchmark_record& b) { return a.time > b.time; });
+
+	// Totals per stage first, then every single record.
+	std::map<std::string, std::pair<std::chrono::nanoseconds, size_t>> totals;
+	for (auto& rec : selected) {
+		auto& total = totals[rec.stage];
+		total.first += rec.time;
+		total.second++;
+	}
+	std::vector<std::pair<std::string, std::pair<std::chrono::nanoseconds, size_t>>> ranked(totals.begin(),
+	                                                                                       totals.end());
+	std::sort(ranked.begin(), ranked.end(),
+	          [](const auto& a, const auto& b) { return a.second.first > b.second.first; });
+
+	PLOG_INFO("Benchmark '%s':", prefix.c_str());
+	for (auto& kv : ranked) {
+		PLOG_INFO("  %-24s %10.3f ms total, %zu calls, %10.3f ms average", kv.first.c_str(),
+		          to_ms(kv.second.first), kv.second.second,
+		          to_ms(kv.second.first) / static_cast<double>(kv.second.second));
+	}
+	for (auto& rec : selected) {
+		PLOG_INFO("  %10.3f ms %-24s %s", to_ms(rec.time), rec.stage.c_str(), rec.subject.c_str());
+	}
+}
+
+void obsffmpeg::benchmark::run_texture_handoff(std::string encoder_id, size_t count)
+{
+	video_t* video = obs_get_video();
+	if (!video) {
+		PLOG_ERROR("Benchmark 'hwapi.system': Video is not initialized.");
+		return;
+	}
+	const video_output_info* voi = video_output_get_info(video);
+
+	auto input = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
+		av_frame_unref(frame);
+		av_frame_free(&frame);
+	});
+	input->width  = static_cast<int>(voi->width);
+	input->height = static_cast<int>(voi->height);
+	input->format = ffmpeg::tools::obs_videoformat_to_avpixelformat(voi->format);
+	if (av_frame_get_buffer(input.get(), 32) < 0) {
+		PLOG_ERROR("Benchmark 'hwapi.system': Failed to allocate input surface.");
+		return;
+	}
+
+	obs_encoder_t* encoder = obs_video_encoder_create(encoder_id.c_str(), "benchmark", nullptr, nullptr);
+	if (!encoder) {
+		PLOG_ERROR("Benchmark 'hwapi.system': Unknown encoder '%s'.", encoder_id.c_str());
+		return;
+	}
+	obs_encoder_set_video(encoder, video);
+	obs_data_t* settings = obs_encoder_get_settings(encoder);
+
+	auto     surface = std::make_shared<obsffmpeg::hwapi::system_surface>(input, 0);
+	uint32_t handle  = obsffmpeg::hwapi::system::register_surface(surface);
+
+	// The producer renders with key 0 and hands the surface over with key 1, like libobs does.
+	std::thread producer([&surface, &input, count]() {
+		for (size_t idx = 0; idx < count; idx++) {
+			if (!surface->acquire(0, std::chrono::milliseconds(1000)))
+				break;
+			input->data[0][0] = static_cast<uint8_t>(idx);
+			surface->release(1);
+		}
+	});
+
+	std::chrono::nanoseconds total(0), fastest(std::chrono::nanoseconds::max()), slowest(0);
+	size_t                   done = 0;
+	try {
+		obsffmpeg::encoder instance(settings, encoder, true);
+		for (; done < count; done++) {
+			auto start = std::chrono::high_resolution_clock::now();
+
+			encoder_packet packet   = {};
+			bool           received = false;
+			uint64_t       next_key = 0;
+			if (!instance.video_encode_texture(handle, static_cast<int64_t>(done), 1, &next_key, &packet,
+			                                   &received))
+				throw std::runtime_error("Failed to encode frame.");
+
+			auto time = std::chrono::high_resolution_clock::now() - start;
+			total += time;
+			fastest = std::min<std::chrono::nanoseconds>(fastest, time);
+			slowest = std::max<std::chrono::nanoseconds>(slowest, time);
+		}
+	} catch (const std::exception& ex) {
+		PLOG_ERROR("Benchmark 'hwapi.system': %s", ex.what());
+	}
+	// Let the producer run out if the consumer stopped early.
+	obsffmpeg::hwapi::system::unregister_surface(handle);
+	surface->release(0);
+	producer.join();
+
+	obs_data_release(settings);
+	obs_encoder_release(encoder);
+
+	if (done == 0)
+		return;
+	record("hwapi.system.handoff", encoder_id, total);
+	PLOG_INFO("Benchmark 'hwapi.system': %zu frames of %" PRIu32 "x%" PRIu32 " with '%s', %10.3f ms average, "
+	          "%10.3f ms fastest, %10.3f ms slowest.",
+	          done, voi->width, voi->height, encoder_id.c_str(), to_ms(total) / static_cast<double>(done),
+	          to_ms(fastest), to_ms(slowest));
+}
+
+#if defined(ENABLE_BENCHMARK) && !defined(WIN32)
+static void _run_texture_handoff(void*, calldata_t* data) noexcept
+try {
+	const char* encoder_id = calldata_string(data, "encoder");
+	long long   count      = calldata_int(data, "count");
+	if (!encoder_id || (count <= 0))
+		return;
+	obsffmpeg::benchmark::run_texture_handoff(encoder_id, static_cast<size_t>(count));
+	BENCHMARK_REPORT("hwapi.");
+} catch (const std::exception& ex) {
+	PLOG_ERROR("Unexpected exception in function '%s': %s.", __FUNCTION_NAME__, ex.what());
+} catch (...) {
+	PLOG_ERROR("Unexpected exception in function '%s'.", __FUNCTION_NAME__);
+}
+
+INITIALIZER(benchmark_procedures_init)
+{
+	obsffmpeg::initializers.push_back([]() {
+		proc_handler_add(obs_get_proc_handler(),
+		                 "void ffmpeg_benchmark_texture_handoff(in string encoder, in int count)",
+		                 _run_texture_handoff, nullptr);
+	});
+};
+#endif
@@ -0,0 +1,61 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <cinttypes>
+#include <string>
+
+// Startup timing, enabled with the ENABLE_BENCHMARK CMake option. Stages are recorded per subject (usually the
+// codec name) and can be logged as a report ranked by time spent.
+#ifdef ENABLE_BENCHMARK
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+#define BENCHMARK_SCOPE(stage, subject) \
+	obsffmpeg::benchmark::scope BENCHMARK_CONCAT(_benchmark_, __LINE__)(stage, subject)
+#define BENCHMARK_REPORT(prefix) obsffmpeg::benchmark::report(prefix)
+#else
+#define BENCHMARK_SCOPE(stage, subject)
+#define BENCHMARK_REPORT(prefix)
+#endif
+
+namespace obsffmpeg {
+	namespace benchmark {
+		class scope {
+			const char*                                    _stage;
+			std::string                                    _subject;
+			std::chrono::high_resolution_clock::time_point _start;
+
+			public:
+			scope(const char* stage, std::string subject);
+			~scope();
+		};
+
+		void record(const char* stage, std::string subject, std::chrono::nanoseconds time);
+
+		// Log all records whose stage starts with prefix, slowest first. Reported records are removed.
+		void report(std::string prefix);
+
+		// Hand frames from a producer thread to video_encode_texture of the given encoder, at the size of the
+		// OBS video output. Only graphics devices without Direct3D 11 use the system memory backend for this.
+		void run_texture_handoff(std::string encoder_id, size_t count);
+	} // namespace benchmark
+} // namespace obsffmpeg
@@ -0,0 +1,279 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "codec_index.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "ffmpeg/tools.hpp"
+#include "plugin.hpp"
+#include "utility.hpp"
+
+#define ST_INDEX_VERSION "Version"
+#define ST_INDEX_ENCODERS "Encoders"
+#define ST_INDEX_ENCODER_NAME "Name"
+#define ST_INDEX_ENCODER_TYPE "Type"
+#define ST_INDEX_ENCODER_CAPABILITIES "Capabilities"
+#define ST_INDEX_ENCODER_SUPPORTED "Supported"
+#define ST_INDEX_ENCODER_HARDWARE "Hardware"
+#define ST_INDEX_ENCODER_PROBED "Probed"
+#define ST_INDEX_ENCODER_AVAILABLE "Available"
+#define ST_INDEX_ENCODER_OPENTIME "OpenTime"
+#define ST_INDEX_ENCODER_PIXELFORMATS "PixelFormats"
+#define ST_INDEX_ENCODER_FAILURES "Failures"
+#define ST_INDEX_ENCODER_PROBETIME "ProbeTime"
+
+#define ST_CONFIG_ALLOW "Encoders.Allow"
+#define ST_CONFIG_DENY "Encoders.Deny"
+#define ST_CONFIG_UNSUPPORTED "Encoders.Unsupported"
+
+static void index_entry(obsffmpeg::codec_index_entry& entry, const AVCodec* cdc)
+{
+	entry.name         = cdc->name;
+	entry.type         = cdc->type;
+	entry.capabilities = cdc->capabilities;
+	entry.supported    = obsffmpeg::has_codec_handler(cdc->name);
+	entry.hardware     = ffmpeg::tools::can_hardware_encode(cdc);
+}
+
+obsffmpeg::codec_index::codec_index() {}
+
+obsffmpeg::codec_index::~codec_index() {}
+
+bool obsffmpeg::codec_index::load(std::string path)
+{
+	_entries.clear();
+
+	obs_data_t* data = obs_data_create_from_json_file(path.c_str());
+	if (!data)
+		return false;
+
+	_version = obs_data_get_string(data, ST_INDEX_VERSION);
+	if (_version != get_current_version()) {
+		obs_data_release(data);
+		return false;
+	}
+
+	obs_data_array_t* encoders = obs_data_get_array(data, ST_INDEX_ENCODERS);
+	for (size_t idx = 0, end = obs_data_array_count(encoders); idx < end; idx++) {
+		obs_data_t*       item = obs_data_array_item(encoders, idx);
+		codec_index_entry entry;
+		entry.name         = obs_data_get_string(item, ST_INDEX_ENCODER_NAME);
+		entry.type         = static_cast<AVMediaType>(obs_data_get_int(item, ST_INDEX_ENCODER_TYPE));
+		entry.capabilities = static_cast<int>(obs_data_get_int(item, ST_INDEX_ENCODER_CAPABILITIES));
+		entry.supported    = obs_data_get_bool(item, ST_INDEX_ENCODER_SUPPORTED);
+		entry.hardware     = obs_data_get_bool(item, ST_INDEX_ENCODER_HARDWARE);
+		entry.probed       = obs_data_get_bool(item, ST_INDEX_ENCODER_PROBED);
+		entry.available    = obs_data_get_bool(item, ST_INDEX_ENCODER_AVAILABLE);
+		entry.open_time    = static_cast<uint64_t>(obs_data_get_int(item, ST_INDEX_ENCODER_OPENTIME));
+		entry.failures     = static_cast<uint32_t>(obs_data_get_int(item, ST_INDEX_ENCODER_FAILURES));
+		entry.probe_time   = obs_data_get_int(item, ST_INDEX_ENCODER_PROBETIME);
+		{
+			obs_data_array_t* formats = obs_data_get_array(item, ST_INDEX_ENCODER_PIXELFORMATS);
+			for (size_t fidx = 0, fend = obs_data_array_count(formats); fidx < fend; fidx++) {
+				obs_data_t* format = obs_data_array_item(formats, fidx);
+				entry.pixel_formats.push_back(obs_data_get_string(format, ST_INDEX_ENCODER_NAME));
+				obs_data_release(format);
+			}
+			obs_data_array_release(formats);
+		}
+		_entries.push_back(entry);
+		obs_data_release(item);
+	}
+	obs_data_array_release(encoders);
+	obs_data_release(data);
+
+	return _entries.size() > 0;
+}
+
+bool obsffmpeg::codec_index::save(std::string path)
+{
+	obs_data_t*       data     = obs_data_create();
+	obs_data_array_t* encoders = obs_data_array_create();
+
+	obs_data_set_string(data, ST_INDEX_VERSION, _version.c_str());
+	for (auto& entry : _entries) {
+		obs_data_t* item = obs_data_create();
+		obs_data_set_string(item, ST_INDEX_ENCODER_NAME, entry.name.c_str());
+		obs_data_set_int(item, ST_INDEX_ENCODER_TYPE, entry.type);
+		obs_data_set_int(item, ST_INDEX_ENCODER_CAPABILITIES, entry.capabilities);
+		obs_data_set_bool(item, ST_INDEX_ENCODER_SUPPORTED, entry.supported);
+		obs_data_set_bool(item, ST_INDEX_ENCODER_HARDWARE, entry.hardware);
+		obs_data_set_bool(item, ST_INDEX_ENCODER_PROBED, entry.probed);
+		obs_data_set_bool(item, ST_INDEX_ENCODER_AVAILABLE, entry.available);
+		obs_data_set_int(item, ST_INDEX_ENCODER_OPENTIME, static_cast<long long>(entry.open_time));
+		obs_data_set_int(item, ST_INDEX_ENCODER_FAILURES, entry.failures);
+		obs_data_set_int(item, ST_INDEX_ENCODER_PROBETIME, entry.probe_time);
+		{
+			obs_data_array_t* formats = obs_data_array_create();
+			for (auto& name : entry.pixel_formats) {
+				obs_data_t* format = obs_data_create();
+				obs_data_set_string(format, ST_INDEX_ENCODER_NAME, name.c_str());
+				obs_data_array_push_back(formats, format);
+				obs_data_release(format);
+			}
+			obs_data_set_array(item, ST_INDEX_ENCODER_PIXELFORMATS, formats);
+			obs_data_array_release(formats);
+		}
+		obs_data_array_push_back(encoders, item);
+		obs_data_release(item);
+	}
+	obs_data_set_array(data, ST_INDEX_ENCODERS, encoders);
+
+	bool res = obs_data_save_json_safe(data, path.c_str(), "tmp", "bak");
+
+	obs_data_array_release(encoders);
+	obs_data_release(data);
+	return res;
+}
+
+#pragma warning(push)
+#pragma warning(disable : 4996) // Handled by software and precompiler branch
+void obsffmpeg::codec_index::for_each_encoder(std::function<void(const AVCodec*)> func)
+{
+#if FF_API_NEXT
+	if (avcodec_version() < AV_VERSION_INT(58, 0, 0)) {
+		AVCodec* cdc = nullptr;
+		while ((cdc = av_codec_next(cdc)) != nullptr) {
+			if (!av_codec_is_encoder(cdc))
+				continue;
+
+			if ((cdc->type == AVMediaType::AVMEDIA_TYPE_AUDIO)
+			    || (cdc->type == AVMediaType::AVMEDIA_TYPE_VIDEO)) {
+				func(cdc);
+			}
+		}
+	} else {
+#endif
+#if LIBAVCODEC_VERSION_MAJOR >= 58
+		void*          storage = nullptr;
+		const AVCodec* cdc     = nullptr;
+		for (cdc = av_codec_iterate(&storage); cdc != nullptr; cdc = av_codec_iterate(&storage)) {
+			if (!av_codec_is_encoder(cdc))
+				continue;
+
+			if ((cdc->type == AVMediaType::AVMEDIA_TYPE_AUDIO)
+			    || (cdc->type == AVMediaType::AVMEDIA_TYPE_VIDEO)) {
+				func(cdc);
+			}
+		}
+#endif
+#if FF_API_NEXT
+	}
+#endif
+}
+#pragma warning(pop)
+
+void obsffmpeg::codec_index::rebuild()
+{
+	_version = get_current_version();
+	_entries.clear();
+
+	for_each_encoder([this](const AVCodec* cdc) {
+		codec_index_entry entry;
+		index_entry(entry, cdc);
+		entry.codec = cdc;
+		_entries.push_back(entry);
+	});
+}
+
+void obsffmpeg::codec_index::resolve()
+{
+	// avcodec_find_encoder_by_name walks the whole list for every name, so map them all at once instead.
+	std::map<std::string, const AVCodec*> codecs;
+	for_each_encoder([&codecs](const AVCodec* cdc) { codecs.emplace(cdc->name, cdc); });
+
+	for (auto& entry : _entries) {
+		auto found  = codecs.find(entry.name);
+		entry.codec = (found != codecs.end()) ? found->second : nullptr;
+	}
+}
+
+std::list<obsffmpeg::codec_index_entry>& obsffmpeg::codec_index::get_entries()
+{
+	return _entries;
+}
+
+const std::string& obsffmpeg::codec_index::get_version()
+{
+	return _version;
+}
+
+std::string obsffmpeg::codec_index::get_current_version()
+{
+	std::stringstream sstr;
+	sstr << avcodec_version() << '|' << avcodec_configuration() << '|' << PROJECT_VERSION_MAJOR << '.'
+	     << PROJECT_VERSION_MINOR << '.' << PROJECT_VERSION_PATCH << '.' << PROJECT_VERSION_BUILD;
+	std::string text = sstr.str();
+
+	// FNV-1a, so the key stays stable across runs and standard libraries.
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : text) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+
+	std::vector<char> buf(17);
+	snprintf(buf.data(), buf.size(), "%016" PRIx64, hash);
+	return std::string(buf.data());
+}
+
+static std::list<std::string> split_names(const char* text)
+{
+	std::list<std::string> names;
+	std::stringstream      sstr{std::string(text ? text : "")};
+	std::string            name;
+	while (std::getline(sstr, name, ',')) {
+		name.erase(0, name.find_first_not_of(" \t"));
+		name.erase(name.find_last_not_of(" \t") + 1);
+		if (name.size() > 0)
+			names.push_back(name);
+	}
+	return names;
+}
+
+obsffmpeg::codec_filter::codec_filter(obs_data_t* config)
+{
+	_allow       = split_names(obs_data_get_string(config, ST_CONFIG_ALLOW));
+	_deny        = split_names(obs_data_get_string(config, ST_CONFIG_DENY));
+	_unsupported = obs_data_get_bool(config, ST_CONFIG_UNSUPPORTED);
+}
+
+bool obsffmpeg::codec_filter::is_allowed(const codec_index_entry& entry)
+{
+	if (std::find(_deny.begin(), _deny.end(), entry.name) != _deny.end())
+		return false;
+
+	if (_allow.size() > 0)
+		return std::find(_allow.begin(), _allow.end(), entry.name) != _allow.end();
+
+	return entry.supported || _unsupported;
+}
+
+void obsffmpeg::codec_filter::get_defaults(obs_data_t* config)
+{
+	obs_data_set_default_string(config, ST_CONFIG_ALLOW, "");
+	obs_data_set_default_string(config, ST_CONFIG_DENY, "");
+	obs_data_set_default_bool(config, ST_CONFIG_UNSUPPORTED, true);
+}
@@ -0,0 +1,97 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+
+extern "C" {
+#include <obs-data.h>
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	struct codec_index_entry {
+		std::string name;
+		AVMediaType type         = AVMEDIA_TYPE_UNKNOWN;
+		int         capabilities = 0;
+		bool        supported    = false;
+		bool        hardware     = false;
+
+		// Availability probe results, see codec_probe.
+		bool                   probed    = false;
+		bool                   available = false;
+		uint64_t               open_time = 0; // in microseconds
+		std::list<std::string> pixel_formats;
+		uint32_t               failures   = 0; // Probes in a row that failed.
+		int64_t                probe_time = 0; // Unix time of the last probe.
+
+		// Encoder of the running FFmpeg, set by rebuild and resolve and never saved.
+		const AVCodec* codec = nullptr;
+	};
+
+	class codec_index {
+		std::string                  _version;
+		std::list<codec_index_entry> _entries;
+
+		public:
+		codec_index();
+		~codec_index();
+
+		// Load a previously saved index, returns false if it is missing or was built for another FFmpeg.
+		bool load(std::string path);
+
+		bool save(std::string path);
+
+		void rebuild();
+
+		// Look up the encoders of a loaded index in one pass over FFmpeg's list.
+		void resolve();
+
+		std::list<codec_index_entry>& get_entries();
+
+		const std::string& get_version();
+
+		// Hash of the libavcodec build and this plugin's version, used as the key of the index.
+		static std::string get_current_version();
+
+		// Every audio and video encoder of FFmpeg, in the order FFmpeg prefers them.
+		static void for_each_encoder(std::function<void(const AVCodec*)> func);
+	};
+
+	class codec_filter {
+		std::list<std::string> _allow;
+		std::list<std::string> _deny;
+		bool                   _unsupported;
+
+		public:
+		codec_filter(obs_data_t* config);
+
+		bool is_allowed(const codec_index_entry& entry);
+
+		static void get_defaults(obs_data_t* config);
+	};
+} // namespace obsffmpeg
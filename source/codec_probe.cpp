@@ -0,0 +1,180 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "codec_probe.hpp"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <vector>
+#include "utility.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#pragma warning(pop)
+}
+
+// Large enough for the minimum size of hardware encoders, small enough to be cheap.
+#define PROBE_WIDTH 640
+#define PROBE_HEIGHT 360
+
+// Failures can be transient, like a busy GPU or the session limit of NVENC, so failed encoders are probed again
+// on the next start. Only after this many failures in a row the result is kept, and then only for a week.
+#define PROBE_FAILURES 3
+#define PROBE_RETRY_SECONDS (7 * 24 * 60 * 60)
+
+static bool probe_open(const AVCodec* codec, AVPixelFormat format, std::chrono::microseconds& time)
+{
+	AVCodecContext* context = avcodec_alloc_context3(codec);
+	if (!context)
+		return false;
+
+	context->width                 = PROBE_WIDTH;
+	context->height                = PROBE_HEIGHT;
+	context->pix_fmt               = format;
+	context->time_base             = {1, 30};
+	context->framerate             = {30, 1};
+	context->ticks_per_frame       = 1;
+	context->gop_size              = 30;
+	context->bit_rate              = 1000000;
+	context->thread_count          = 1;
+	context->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	int  res   = avcodec_open2(context, codec, nullptr);
+	time       = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()
+                                                                         - start);
+
+	avcodec_free_context(&context);
+	return res >= 0;
+}
+
+obsffmpeg::codec_probe::codec_probe(codec_index index, codec_filter filter, std::string path)
+    : _index(index), _filter(filter), _path(path), _abort(false)
+{
+	_worker = std::thread([this]() { this->worker(); });
+}
+
+obsffmpeg::codec_probe::~codec_probe()
+{
+	_abort = true;
+	if (_worker.joinable())
+		_worker.join();
+}
+
+void obsffmpeg::codec_probe::worker()
+try {
+	std::vector<codec_index_entry*> probed;
+	for (auto& entry : _index.get_entries()) {
+		if (_abort)
+			return;
+		if (!should_probe(entry) || !_filter.is_allowed(entry))
+			continue;
+		if (probe(entry))
+			probed.push_back(&entry);
+	}
+
+	if (probed.size() == 0)
+		return;
+
+	if (!_index.save(_path)) {
+		PLOG_WARNING("Failed to save probe results to '%s'.", _path.c_str());
+	}
+
+	// Report fastest-starting encoders first.
+	std::sort(probed.begin(), probed.end(), [](const codec_index_entry* a, const codec_index_entry* b) {
+		if (a->available != b->available)
+			return a->available;
+		return a->open_time < b->open_time;
+	});
+	PLOG_INFO("Probed %zu encoders:", probed.size());
+	for (auto entry : probed) {
+		if (entry->available) {
+			std::string formats;
+			for (auto& name : entry->pixel_formats) {
+				formats += (formats.size() > 0 ? ", " : "") + name;
+			}
+			PLOG_INFO("  %s: opened in %.3f ms (%s)", entry->name.c_str(),
+			          static_cast<double>(entry->open_time) / 1000.0, formats.c_str());
+		} else {
+			PLOG_INFO("  %s: unavailable", entry->name.c_str());
+		}
+	}
+} catch (const std::exception& ex) {
+	PLOG_ERROR("Unexpected exception while probing encoders: %s.", ex.what());
+} catch (...) {
+	PLOG_ERROR("Unexpected exception while probing encoders.");
+}
+
+bool obsffmpeg::codec_probe::probe(codec_index_entry& entry)
+{
+	const AVCodec* codec = entry.codec;
+	if (!codec)
+		return false;
+
+	// Formats which require a hardware frames context can't be opened without a device.
+	std::vector<AVPixelFormat> formats;
+	if (codec->pix_fmts) {
+		for (auto ptr = codec->pix_fmts; *ptr != AV_PIX_FMT_NONE; ptr++) {
+			const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(*ptr);
+			if (desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+				formats.push_back(*ptr);
+		}
+	} else {
+		formats.push_back(AV_PIX_FMT_YUV420P);
+	}
+	if (formats.size() == 0)
+		return false;
+
+	entry.probed     = true;
+	entry.available  = false;
+	entry.open_time  = 0;
+	entry.probe_time = static_cast<int64_t>(std::time(nullptr));
+	entry.pixel_formats.clear();
+	for (auto format : formats) {
+		std::chrono::microseconds time;
+		if (!probe_open(codec, format, time))
+			continue;
+
+		if (!entry.available || (static_cast<uint64_t>(time.count()) < entry.open_time))
+			entry.open_time = static_cast<uint64_t>(time.count());
+		entry.available = true;
+		entry.pixel_formats.push_back(av_get_pix_fmt_name(format));
+	}
+	entry.failures = entry.available ? 0 : (entry.failures + 1);
+	return true;
+}
+
+bool obsffmpeg::codec_probe::should_probe(const codec_index_entry& entry)
+{
+	if (entry.type != AVMediaType::AVMEDIA_TYPE_VIDEO)
+		return false;
+	if (!entry.supported && !entry.hardware)
+		return false;
+	if (!entry.probed || entry.available)
+		return !entry.probed;
+
+	if (entry.failures < PROBE_FAILURES)
+		return true;
+	return (static_cast<int64_t>(std::time(nullptr)) - entry.probe_time) >= PROBE_RETRY_SECONDS;
+}
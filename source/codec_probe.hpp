@@ -0,0 +1,52 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include "codec_index.hpp"
+
+namespace obsffmpeg {
+	// Opens encoders with a tiny configuration on a worker thread to find out if they actually work on this
+	// machine. Results are written back into the codec index, so that they only have to be gathered once per
+	// FFmpeg build.
+	class codec_probe {
+		codec_index       _index;
+		codec_filter      _filter;
+		std::string       _path;
+		std::thread       _worker;
+		std::atomic<bool> _abort;
+
+		void worker();
+
+		public:
+		codec_probe(codec_index index, codec_filter filter, std::string path);
+		~codec_probe();
+
+		// Probe a single encoder, returns false if there was no pixel format we could try.
+		static bool probe(codec_index_entry& entry);
+
+		// Only probe encoders we actually support, or the ones that need specific hardware. Failed encoders are
+		// probed again, until they failed often enough to be sure.
+		static bool should_probe(const codec_index_entry& entry);
+	};
+} // namespace obsffmpeg
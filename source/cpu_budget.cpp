@@ -0,0 +1,105 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "cpu_budget.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "plugin.hpp"
+
+#define ST_CONFIG_ENABLED "CPUBudget.Enabled"
+#define ST_CONFIG_CORES "CPUBudget.Cores"
+
+// Part of the cores that is held back for encoders that open later, open encoders can't give threads back.
+#define BUDGET_HEADROOM 0.25
+
+struct budget_entry {
+	double weight;
+	int    threads;
+};
+
+static std::mutex                          budget_lock;
+static std::map<const void*, budget_entry> budget;
+static uint64_t                            budget_assignments = 0;
+
+void obsffmpeg::cpu_budget::get_defaults(obs_data_t* config)
+{
+	obs_data_set_default_bool(config, ST_CONFIG_ENABLED, true);
+	obs_data_set_default_int(config, ST_CONFIG_CORES, 0);
+}
+
+bool obsffmpeg::cpu_budget::is_enabled()
+{
+	obs_data_t* config = obsffmpeg::get_global_config();
+	return config && obs_data_get_bool(config, ST_CONFIG_ENABLED);
+}
+
+size_t obsffmpeg::cpu_budget::get_cores()
+{
+	obs_data_t* config = obsffmpeg::get_global_config();
+	int64_t     cores  = config ? obs_data_get_int(config, ST_CONFIG_CORES) : 0;
+	if (cores <= 0)
+		return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	return static_cast<size_t>(cores);
+}
+
+int obsffmpeg::cpu_budget::assign(const void* owner, double weight)
+{
+	size_t                      cores = get_cores();
+	std::lock_guard<std::mutex> lock(budget_lock);
+
+	auto& entry  = budget[owner];
+	entry.weight = std::max(weight, 1.0);
+
+	double total = 0;
+	for (auto& kv : budget) {
+		total += kv.second.weight;
+	}
+
+	// Split what is left after the headroom by weight among all registered encoders, so that one opened later
+	// still gets a share that matches its resolution and frame rate. Every encoder gets at least one thread.
+	double usable = static_cast<double>(cores) * (1.0 - BUDGET_HEADROOM);
+	entry.threads = std::max(1, static_cast<int>(std::lround(usable * entry.weight / total)));
+	budget_assignments++;
+	return entry.threads;
+}
+
+void obsffmpeg::cpu_budget::release(const void* owner)
+{
+	std::lock_guard<std::mutex> lock(budget_lock);
+	budget.erase(owner);
+}
+
+obsffmpeg::cpu_budget_counters obsffmpeg::cpu_budget::get_counters()
+{
+	cpu_budget_counters counters = {};
+	counters.cores               = get_cores();
+
+	std::lock_guard<std::mutex> lock(budget_lock);
+	counters.encoders    = budget.size();
+	counters.assignments = budget_assignments;
+	for (auto& kv : budget) {
+		counters.threads += static_cast<size_t>(kv.second.threads);
+	}
+	return counters;
+}
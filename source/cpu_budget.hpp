@@ -0,0 +1,56 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cinttypes>
+#include <cstddef>
+
+extern "C" {
+#include <obs.h>
+}
+
+namespace obsffmpeg {
+	struct cpu_budget_counters {
+		size_t   cores;       // Cores split among the encoders.
+		size_t   encoders;    // Encoders currently holding a share.
+		size_t   threads;     // Threads currently handed out to them, in total.
+		uint64_t assignments; // Shares handed out since the module was loaded.
+	};
+
+	// Splits a process-wide number of cores among all live software video encoders, weighted by the pixels per
+	// second each of them encodes. Shares are computed whenever a context is created, contexts that are already
+	// open keep their thread count until they are reopened, so part of the cores is always held back for encoders
+	// that open later.
+	namespace cpu_budget {
+		void get_defaults(obs_data_t* config);
+
+		bool is_enabled();
+
+		size_t get_cores();
+
+		// Register or update an encoder, returns the number of threads it should use.
+		int assign(const void* owner, double weight);
+
+		void release(const void* owner);
+
+		cpu_budget_counters get_counters();
+	} // namespace cpu_budget
+} // namespace obsffmpeg
@@ -20,6 +20,7 @@
 // SOFTWARE.
 
 #include "encoder.hpp"
+#include <cstdlib>
 #include <iomanip>
 #include <set>
 #include <sstream>
@@ -27,10 +28,13 @@
 #include <thread>
 #include <util/profiler.hpp>
 #include <vector>
+#include "benchmark.hpp"
 #include "codecs/hevc.hpp"
+#include "cpu_budget.hpp"
 #include "ffmpeg/tools.hpp"
 #include "plugin.hpp"
 #include "strings.hpp"
+#include "thread_pool.hpp"
 #include "utility.hpp"
 
 extern "C" {
@@ -39,10 +43,15 @@ extern "C" {
 #pragma warning(push)
 #pragma warning(disable : 4244)
 #include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
 #include <libavutil/dict.h>
 #include <libavutil/frame.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/opt.h>
+#include <libavutil/parseutils.h>
 #include <libavutil/pixdesc.h>
+#include <libavutil/samplefmt.h>
 #pragma warning(pop)
 }
 
@@ -56,6 +65,14 @@ extern "C" {
 #ifdef WIN32
 #define HARDWARE_ENCODING
 #include "hwapi/d3d11.hpp"
+#else
+#include "hwapi/system.hpp"
+#endif
+#ifdef ENABLE_FAULT_INJECTION
+#include "hwapi/fault.hpp"
+#endif
+#ifdef ENABLE_OUT_OF_PROCESS
+#include "remote_encoder.hpp"
 #endif
 
 // FFmpeg
@@ -65,15 +82,80 @@ extern "C" {
 #define ST_FFMPEG_COLORFORMAT "FFmpeg.ColorFormat"
 #define ST_FFMPEG_STANDARDCOMPLIANCE "FFmpeg.StandardCompliance"
 #define ST_FFMPEG_GPU "FFmpeg.GPU"
+#define ST_FFMPEG_BITSTREAMFILTERS "FFmpeg.BitstreamFilters"
+#define ST_FFMPEG_GOVERNOR "FFmpeg.Governor"
+#define ST_FFMPEG_DROPLATEFRAMES "FFmpeg.DropLateFrames"
+#define ST_FFMPEG_OUTOFPROCESS "FFmpeg.OutOfProcess"
+#define ST_FFMPEG_PARALLEL "FFmpeg.Parallel"
+#define ST_FFMPEG_ASYNCOPEN "FFmpeg.AsyncOpen"
+#define ST_FFMPEG_AFFINITY "FFmpeg.Affinity"
+#define ST_FFMPEG_PRIORITY "FFmpeg.Priority"
+#define ST_FFMPEG_BATCHSCHEDULING "FFmpeg.BatchScheduling"
+#define ST_FFMPEG_FRAMERATEDIVIDER "FFmpeg.FrameRateDivider"
+#define ST_FFMPEG_FRAMERATE "FFmpeg.FrameRate"
+
+// Memory for frames buffered while a context opens in the background, later frames are dropped until the encoder
+// caught up with the buffer.
+#define STARTUP_BYTES_MAX (128 * 1024 * 1024)
+
+// Hardware errors in a row after which a texture encoder switches to software encoding.
+#define FAILOVER_ERRORS 3
 
 enum class keyframe_type { SECONDS, FRAMES };
 
+// Encoders have no procedure handler of their own in OBS Studio, so the procedures are on the global one and take
+// the encoder as a parameter.
+static std::mutex                                    instances_lock;
+static std::map<obs_encoder_t*, obsffmpeg::encoder*> instances;
+
+static void* register_instance(obs_encoder_t* encoder, obsffmpeg::encoder* instance)
+{
+	std::lock_guard<std::mutex> lock(instances_lock);
+	instances[encoder] = instance;
+	return instance;
+}
+
+static void unregister_instance(obsffmpeg::encoder* instance)
+{
+	std::lock_guard<std::mutex> lock(instances_lock);
+	for (auto it = instances.begin(); it != instances.end(); ++it) {
+		if (it->second == instance) {
+			instances.erase(it);
+			break;
+		}
+	}
+}
+
+static void _request_keyframe(void*, calldata_t* data) noexcept
+try {
+	auto encoder = reinterpret_cast<obs_encoder_t*>(calldata_ptr(data, "encoder"));
+
+	std::lock_guard<std::mutex> lock(instances_lock);
+	auto                        found = instances.find(encoder);
+	if (found != instances.end())
+		found->second->request_keyframe();
+	calldata_set_bool(data, "success", found != instances.end());
+} catch (const std::exception& ex) {
+	PLOG_ERROR("Unexpected exception in function '%s': %s.", __FUNCTION_NAME__, ex.what());
+} catch (...) {
+	PLOG_ERROR("Unexpected exception in function '%s'.", __FUNCTION_NAME__);
+}
+
+INITIALIZER(encoder_procedures_init)
+{
+	obsffmpeg::initializers.push_back([]() {
+		proc_handler_add(obs_get_proc_handler(),
+		                 "void ffmpeg_encoder_request_keyframe(in ptr encoder, out bool success)",
+		                 _request_keyframe, nullptr);
+	});
+};
+
 static void* _create(obs_data_t* settings, obs_encoder_t* encoder) noexcept
 try {
 #ifdef DEBUG_CALL_ORDER
 	PLOG_INFO("%s %llX %llX", __FUNCTION_NAME__, settings, encoder);
 #endif
-	return reinterpret_cast<void*>(new obsffmpeg::encoder(settings, encoder));
+	return register_instance(encoder, new obsffmpeg::encoder(settings, encoder));
 } catch (const std::exception& ex) {
 	PLOG_ERROR("Unexpected exception in function '%s': %s.", __FUNCTION_NAME__, ex.what());
 	return nullptr;
@@ -87,7 +169,7 @@ try {
 #ifdef DEBUG_CALL_ORDER
 	PLOG_INFO("%s %llX %llX", __FUNCTION_NAME__, settings, encoder);
 #endif
-	return reinterpret_cast<void*>(new obsffmpeg::encoder(settings, encoder, true));
+	return register_instance(encoder, new obsffmpeg::encoder(settings, encoder, true));
 } catch (const obsffmpeg::unsupported_gpu_exception&) {
 	obsffmpeg::encoder_factory* fac =
 	    reinterpret_cast<obsffmpeg::encoder_factory*>(obs_encoder_get_type_data(encoder));
@@ -107,8 +189,10 @@ try {
 #ifdef DEBUG_CALL_ORDER
 	PLOG_INFO("%s %llX", __FUNCTION_NAME__, ptr);
 #endif
-	if (ptr)
+	if (ptr) {
+		unregister_instance(reinterpret_cast<obsffmpeg::encoder*>(ptr));
 		delete reinterpret_cast<obsffmpeg::encoder*>(ptr);
+	}
 } catch (const std::exception& ex) {
 	PLOG_ERROR("Unexpected exception in function '%s': %s.", __FUNCTION_NAME__, ex.what());
 } catch (...) {
@@ -336,7 +420,9 @@ try {
 	return false;
 }
 
-obsffmpeg::encoder_factory::encoder_factory(const AVCodec* codec) : avcodec_ptr(codec), info(), info_fallback()
+obsffmpeg::encoder_factory::encoder_factory(const codec_index_entry& entry)
+    : info(), info_fallback(), avcodec_ptr(entry.codec), _supported(entry.supported), _hardware(entry.hardware),
+      _unavailable(false)
 {
 	// Find Codec UI handler.
 	_handler = obsffmpeg::find_codec_handler(avcodec_ptr->name);
@@ -344,19 +430,6 @@ obsffmpeg::encoder_factory::encoder_factory(const AVCodec* codec) : avcodec_ptr(
 	// Unique Id is FFmpeg name.
 	info.uid = std::string("obs-ffmpeg-encoder_") + avcodec_ptr->name;
 
-	// Also generate a human readable name while we're at it.
-	{
-		std::stringstream sstr;
-		if (!obsffmpeg::has_codec_handler(avcodec_ptr->name)) {
-			sstr << "[UNSUPPORTED] ";
-		}
-		sstr << (avcodec_ptr->long_name ? avcodec_ptr->long_name : avcodec_ptr->name);
-		if (avcodec_ptr->long_name) {
-			sstr << " (" << avcodec_ptr->name << ")";
-		}
-		info.readable_name = sstr.str();
-	}
-
 	// Assign Ids.
 	{
 		const AVCodecDescriptor* desc = avcodec_descriptor_get(avcodec_ptr->id);
@@ -374,17 +447,21 @@ obsffmpeg::encoder_factory::encoder_factory(const AVCodec* codec) : avcodec_ptr(
 
 #ifndef _DEBUG
 	// Is this a deprecated encoder?
-	if (!obsffmpeg::has_codec_handler(avcodec_ptr->name)) {
+	if (!_supported) {
 		info.oei.caps |= OBS_ENCODER_CAP_DEPRECATED;
 	}
 #endif
 
+	// Can the bitrate change while encoding?
+	if (_handler && _handler->has_dynamic_bitrate_support(avcodec_ptr)) {
+		info.oei.caps |= OBS_ENCODER_CAP_DYN_BITRATE;
+	}
+
 	// Hardware encoder?
 #ifdef HARDWARE_ENCODING
-	if (ffmpeg::tools::can_hardware_encode(avcodec_ptr)) {
+	if (_hardware) {
 		info_fallback.uid           = info.uid + "_sw";
 		info_fallback.codec         = info.codec;
-		info_fallback.readable_name = info.readable_name + " (Software)";
 
 		// Copy capabilities and hide from view.
 		info_fallback.oei.id    = info_fallback.uid.c_str();
@@ -399,6 +476,39 @@ obsffmpeg::encoder_factory::encoder_factory(const AVCodec* codec) : avcodec_ptr(
 
 obsffmpeg::encoder_factory::~encoder_factory() {}
 
+void obsffmpeg::encoder_factory::build_names()
+{
+	std::stringstream sstr;
+	if (!_supported) {
+		sstr << "[UNSUPPORTED] ";
+	}
+	sstr << (avcodec_ptr->long_name ? avcodec_ptr->long_name : avcodec_ptr->name);
+	if (avcodec_ptr->long_name) {
+		sstr << " (" << avcodec_ptr->name << ")";
+	}
+	info.readable_name = sstr.str();
+	if (info_fallback.uid.size() > 0)
+		info_fallback.readable_name = info.readable_name + " (Software)";
+
+	if (_handler)
+		_handler->adjust_encoder_info(this, &info, &info_fallback);
+
+	if (_unavailable) {
+		info.readable_name = "[UNAVAILABLE] " + info.readable_name;
+		if (info_fallback.uid.size() > 0)
+			info_fallback.readable_name = "[UNAVAILABLE] " + info_fallback.readable_name;
+	}
+}
+
+void obsffmpeg::encoder_factory::mark_unavailable()
+{
+	_unavailable = true;
+	info.oei.caps |= OBS_ENCODER_CAP_DEPRECATED;
+	if (info_fallback.uid.size() > 0) {
+		info_fallback.oei.caps |= OBS_ENCODER_CAP_DEPRECATED;
+	}
+}
+
 void obsffmpeg::encoder_factory::register_encoder()
 {
 	// Detect encoder type (only Video and Audio supported)
@@ -430,7 +540,7 @@ void obsffmpeg::encoder_factory::register_encoder()
 	// Finally store ourself as type data.
 	info.oei.type_data = this;
 
-	if (ffmpeg::tools::can_hardware_encode(avcodec_ptr)) {
+	if (_hardware) {
 		info.oei.create          = _create_texture;
 		info.oei.encode_texture  = _encode_texture;
 		info.oei.get_defaults2   = _get_defaults_texture;
@@ -452,12 +562,10 @@ void obsffmpeg::encoder_factory::register_encoder()
 	} else {
 		// Is not a GPU Encoder, don't implement fallback.
 		info.oei.create = _create;
-		info.oei.encode = _encode;
+		if (avcodec_ptr->type == AVMediaType::AVMEDIA_TYPE_VIDEO)
+			info.oei.encode = _encode;
 	}
 
-	if (_handler)
-		_handler->adjust_encoder_info(this, &info, &info_fallback);
-
 	obs_register_encoder(&info.oei);
 	PLOG_DEBUG("Registered encoder #%llX with name '%s' and long name '%s' and caps %llX", avcodec_ptr,
 	           avcodec_ptr->name, avcodec_ptr->long_name, avcodec_ptr->capabilities);
@@ -472,20 +580,34 @@ void obsffmpeg::encoder_factory::get_defaults(obs_data_t* settings, bool hw_enco
 	if (_handler)
 		_handler->get_defaults(settings, avcodec_ptr, nullptr, hw_encode);
 
-	if ((avcodec_ptr->capabilities & AV_CODEC_CAP_INTRA_ONLY) == 0) {
+	if ((avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) && ((avcodec_ptr->capabilities & AV_CODEC_CAP_INTRA_ONLY) == 0)) {
 		obs_data_set_default_int(settings, S_KEYFRAMES_INTERVALTYPE, 0);
 		obs_data_set_default_double(settings, S_KEYFRAMES_INTERVAL_SECONDS, 2.0);
 		obs_data_set_default_int(settings, S_KEYFRAMES_INTERVAL_FRAMES, 300);
+		if (ffmpeg::tools::has_private_option(avcodec_ptr, "intra-refresh"))
+			obs_data_set_default_bool(settings, S_KEYFRAMES_INTRAREFRESH, false);
 	}
 
 	{ // Integrated Options
 		// FFmpeg
 		obs_data_set_default_string(settings, ST_FFMPEG_CUSTOMSETTINGS, "");
+		obs_data_set_default_string(settings, ST_FFMPEG_BITSTREAMFILTERS, "");
+		obs_data_set_default_bool(settings, ST_FFMPEG_DROPLATEFRAMES, false);
+		obs_data_set_default_int(settings, ST_FFMPEG_FRAMERATEDIVIDER, 1);
+		obs_data_set_default_string(settings, ST_FFMPEG_FRAMERATE, "");
 		if (!hw_encode) {
 			obs_data_set_default_int(settings, ST_FFMPEG_COLORFORMAT,
 			                         static_cast<int64_t>(AV_PIX_FMT_NONE));
 			obs_data_set_default_int(settings, ST_FFMPEG_THREADS, 0);
 			obs_data_set_default_int(settings, ST_FFMPEG_GPU, 0);
+			obs_data_set_default_int(settings, ST_FFMPEG_GOVERNOR,
+			                         static_cast<int64_t>(obsffmpeg::governor::mode::DISABLED));
+			obs_data_set_default_bool(settings, ST_FFMPEG_OUTOFPROCESS, false);
+			obs_data_set_default_int(settings, ST_FFMPEG_PARALLEL, 1);
+			obs_data_set_default_bool(settings, ST_FFMPEG_ASYNCOPEN, false);
+			obs_data_set_default_string(settings, ST_FFMPEG_AFFINITY, "");
+			obs_data_set_default_int(settings, ST_FFMPEG_PRIORITY, 0);
+			obs_data_set_default_bool(settings, ST_FFMPEG_BATCHSCHEDULING, false);
 		}
 		obs_data_set_default_int(settings, ST_FFMPEG_STANDARDCOMPLIANCE, FF_COMPLIANCE_STRICT);
 	}
@@ -510,7 +632,7 @@ void obsffmpeg::encoder_factory::get_properties(obs_properties_t* props, bool hw
 	if (_handler)
 		_handler->get_properties(props, avcodec_ptr, nullptr, hw_encode);
 
-	if ((avcodec_ptr->capabilities & AV_CODEC_CAP_INTRA_ONLY) == 0) {
+	if ((avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) && ((avcodec_ptr->capabilities & AV_CODEC_CAP_INTRA_ONLY) == 0)) {
 		// Key-Frame Options
 		obs_properties_t* grp = props;
 		if (!obsffmpeg::are_property_groups_broken()) {
@@ -541,6 +663,11 @@ void obsffmpeg::encoder_factory::get_properties(obs_properties_t* props, bool hw
 			obs_property_set_long_description(p, TRANSLATE(DESC(S_KEYFRAMES_INTERVAL)));
 			obs_property_int_set_suffix(p, " frames");
 		}
+		if (ffmpeg::tools::has_private_option(avcodec_ptr, "intra-refresh")) {
+			auto p =
+			    obs_properties_add_bool(grp, S_KEYFRAMES_INTRAREFRESH, TRANSLATE(S_KEYFRAMES_INTRAREFRESH));
+			obs_property_set_long_description(p, TRANSLATE(DESC(S_KEYFRAMES_INTRAREFRESH)));
+		}
 	}
 
 	{
@@ -557,8 +684,29 @@ void obsffmpeg::encoder_factory::get_properties(obs_properties_t* props, bool hw
 			                            obs_text_type::OBS_TEXT_DEFAULT);
 			obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_CUSTOMSETTINGS)));
 		}
+		{
+			auto p = obs_properties_add_text(grp, ST_FFMPEG_BITSTREAMFILTERS,
+			                                 TRANSLATE(ST_FFMPEG_BITSTREAMFILTERS),
+			                                 obs_text_type::OBS_TEXT_DEFAULT);
+			obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_BITSTREAMFILTERS)));
+		}
+		if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+			auto p =
+			    obs_properties_add_bool(grp, ST_FFMPEG_DROPLATEFRAMES, TRANSLATE(ST_FFMPEG_DROPLATEFRAMES));
+			obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_DROPLATEFRAMES)));
+		}
+		if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+			auto p = obs_properties_add_int_slider(grp, ST_FFMPEG_FRAMERATEDIVIDER,
+			                                       TRANSLATE(ST_FFMPEG_FRAMERATEDIVIDER), 1, 10, 1);
+			obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_FRAMERATEDIVIDER)));
+		}
+		if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+			auto p = obs_properties_add_text(grp, ST_FFMPEG_FRAMERATE, TRANSLATE(ST_FFMPEG_FRAMERATE),
+			                                 OBS_TEXT_DEFAULT);
+			obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_FRAMERATE)));
+		}
 		if (!hw_encode) {
-			{
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
 				auto p = obs_properties_add_int(grp, ST_FFMPEG_GPU, TRANSLATE(ST_FFMPEG_GPU), 0,
 				                                std::numeric_limits<uint8_t>::max(), 1);
 				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_GPU)));
@@ -570,9 +718,8 @@ void obsffmpeg::encoder_factory::get_properties(obs_properties_t* props, bool hw
 				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_COLORFORMAT)));
 				obs_property_list_add_int(p, TRANSLATE(S_STATE_AUTOMATIC),
 				                          static_cast<int64_t>(AV_PIX_FMT_NONE));
-				for (auto ptr = avcodec_ptr->pix_fmts; *ptr != AV_PIX_FMT_NONE; ptr++) {
-					obs_property_list_add_int(p, ffmpeg::tools::get_pixel_format_name(*ptr),
-					                          static_cast<int64_t>(*ptr));
+				for (auto const& kv : get_pixel_formats()) {
+					obs_property_list_add_int(p, kv.second.c_str(), static_cast<int64_t>(kv.first));
 				}
 			}
 			if (avcodec_ptr->capabilities & (AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS)) {
@@ -581,6 +728,54 @@ void obsffmpeg::encoder_factory::get_properties(obs_properties_t* props, bool hw
 				                                  0, std::thread::hardware_concurrency() * 2, 1);
 				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_THREADS)));
 			}
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p = obs_properties_add_list(grp, ST_FFMPEG_GOVERNOR, TRANSLATE(ST_FFMPEG_GOVERNOR),
+				                                 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_GOVERNOR)));
+				obs_property_list_add_int(p, TRANSLATE(ST_FFMPEG_GOVERNOR ".Disabled"),
+				                          static_cast<int64_t>(obsffmpeg::governor::mode::DISABLED));
+				obs_property_list_add_int(p, TRANSLATE(ST_FFMPEG_GOVERNOR ".Preset"),
+				                          static_cast<int64_t>(obsffmpeg::governor::mode::PRESET));
+				obs_property_list_add_int(p, TRANSLATE(ST_FFMPEG_GOVERNOR ".Resolution"),
+				                          static_cast<int64_t>(obsffmpeg::governor::mode::RESOLUTION));
+				obs_property_list_add_int(p, TRANSLATE(ST_FFMPEG_GOVERNOR ".FrameRate"),
+				                          static_cast<int64_t>(obsffmpeg::governor::mode::FRAMERATE));
+			}
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p = obs_properties_add_int_slider(grp, ST_FFMPEG_PARALLEL,
+				                                       TRANSLATE(ST_FFMPEG_PARALLEL), 1,
+				                                       std::thread::hardware_concurrency(), 1);
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_PARALLEL)));
+			}
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p =
+				    obs_properties_add_bool(grp, ST_FFMPEG_ASYNCOPEN, TRANSLATE(ST_FFMPEG_ASYNCOPEN));
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_ASYNCOPEN)));
+			}
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p = obs_properties_add_text(grp, ST_FFMPEG_AFFINITY, TRANSLATE(ST_FFMPEG_AFFINITY),
+				                                 OBS_TEXT_DEFAULT);
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_AFFINITY)));
+			}
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p = obs_properties_add_int_slider(grp, ST_FFMPEG_PRIORITY,
+				                                       TRANSLATE(ST_FFMPEG_PRIORITY), 0, 19, 1);
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_PRIORITY)));
+			}
+#ifdef __linux__
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p = obs_properties_add_bool(grp, ST_FFMPEG_BATCHSCHEDULING,
+				                                 TRANSLATE(ST_FFMPEG_BATCHSCHEDULING));
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_BATCHSCHEDULING)));
+			}
+#endif
+#ifdef ENABLE_OUT_OF_PROCESS
+			if (avcodec_ptr->type == AVMEDIA_TYPE_VIDEO) {
+				auto p = obs_properties_add_bool(grp, ST_FFMPEG_OUTOFPROCESS,
+				                                 TRANSLATE(ST_FFMPEG_OUTOFPROCESS));
+				obs_property_set_long_description(p, TRANSLATE(DESC(ST_FFMPEG_OUTOFPROCESS)));
+			}
+#endif
 		}
 		{
 			auto p = obs_properties_add_list(grp, ST_FFMPEG_STANDARDCOMPLIANCE,
@@ -606,16 +801,66 @@ const AVCodec* obsffmpeg::encoder_factory::get_avcodec()
 	return avcodec_ptr;
 }
 
+bool obsffmpeg::encoder_factory::is_hardware()
+{
+	return _hardware;
+}
+
+bool obsffmpeg::encoder_factory::is_unavailable()
+{
+	return _unavailable;
+}
+
 const obsffmpeg::encoder_info& obsffmpeg::encoder_factory::get_info()
 {
+	std::call_once(_names_once, [this]() { build_names(); });
 	return info;
 }
 
 const obsffmpeg::encoder_info& obsffmpeg::encoder_factory::get_fallback()
 {
+	std::call_once(_names_once, [this]() { build_names(); });
 	return info_fallback;
 }
 
+const std::list<std::pair<AVPixelFormat, std::string>>& obsffmpeg::encoder_factory::get_pixel_formats()
+{
+	std::call_once(_pixel_formats_once, [this]() {
+		for (auto ptr = avcodec_ptr->pix_fmts; ptr && (*ptr != AV_PIX_FMT_NONE); ptr++) {
+			const char* name = ffmpeg::tools::get_pixel_format_name(*ptr);
+			_pixel_formats.emplace_back(*ptr, name ? name : "<Unknown>");
+		}
+	});
+	return _pixel_formats;
+}
+
+const ffmpeg::option_index& obsffmpeg::encoder_factory::get_option_index()
+{
+	std::call_once(_options_once, [this]() {
+		_options = std::make_unique<ffmpeg::option_index>(avcodec_ptr);
+		_options->log(avcodec_ptr->name, LOG_DEBUG);
+	});
+	return *_options;
+}
+
+std::shared_ptr<const ffmpeg::option_set> obsffmpeg::encoder_factory::get_option_set(const std::string& text)
+{
+	uint64_t                    hash = ffmpeg::option_set::hash(text);
+	std::unique_lock<std::mutex> ulock(_option_sets_lock);
+
+	auto found = _option_sets.find(hash);
+	if ((found != _option_sets.end()) && (found->second->get_text() == text))
+		return found->second;
+
+	// Only the most recent sets are interesting, don't let edits in the properties accumulate.
+	if (_option_sets.size() >= 16)
+		_option_sets.clear();
+
+	auto set = std::make_shared<const ffmpeg::option_set>(text, get_option_index());
+	_option_sets[hash] = set;
+	return set;
+}
+
 void obsffmpeg::encoder::initialize_sw(obs_data_t* settings)
 {
 	if (_codec->type == AVMEDIA_TYPE_VIDEO) {
@@ -668,8 +913,14 @@ void obsffmpeg::encoder::initialize_sw(obs_data_t* settings)
 		_swscale.set_target_color(_context->color_range == AVCOL_RANGE_JPEG, _context->colorspace);
 		_swscale.set_target_format(_pixfmt_target);
 
-		// Create Scaler
-		if (!_swscale.initialize(SWS_POINT)) {
+		// Create Scaler, or take over the one of a previous encoder with the same conversion.
+		obsffmpeg::resources res;
+		if (obsffmpeg::resource_cache::acquire(get_resource_key(SWS_POINT), res)) {
+			PLOG_DEBUG("[%s] Reusing scaler and %zu frames of a previous encoder.", _codec->name,
+			           res.frames.size());
+			_swscale.adopt(res.scaler, SWS_POINT);
+			_free_frames.swap(res.frames);
+		} else if (!_swscale.initialize(SWS_POINT)) {
 			std::stringstream sstr;
 			sstr << "Initializing scaler failed for conversion from '"
 			     << ffmpeg::tools::get_pixel_format_name(_swscale.get_source_format()) << "' to '"
@@ -679,6 +930,78 @@ void obsffmpeg::encoder::initialize_sw(obs_data_t* settings)
 			     << (_swscale.is_source_full_range() ? "full" : "partial") << " range.";
 			throw std::runtime_error(sstr.str());
 		}
+	} else if (_codec->type == AVMEDIA_TYPE_AUDIO) {
+		// Initialize Audio Encoding
+		auto aoi = audio_output_get_info(obs_encoder_audio(_self));
+
+		// Find a sample format OBS can convert to, planar float is what OBS mixes in and needs no conversion.
+		AVSampleFormat sample_fmt = AV_SAMPLE_FMT_NONE;
+		for (auto ptr = _codec->sample_fmts; ptr && (*ptr != AV_SAMPLE_FMT_NONE); ptr++) {
+			if (ffmpeg::tools::avsampleformat_to_obs_audioformat(*ptr) == AUDIO_FORMAT_UNKNOWN)
+				continue;
+			if ((sample_fmt == AV_SAMPLE_FMT_NONE) || (*ptr == AV_SAMPLE_FMT_FLTP))
+				sample_fmt = *ptr;
+		}
+		AVSampleFormat sample_fmt_source = sample_fmt;
+		if (sample_fmt == AV_SAMPLE_FMT_NONE) {
+			// Convert formats OBS doesn't know about ourselves.
+			if (!_codec->sample_fmts || (_codec->sample_fmts[0] == AV_SAMPLE_FMT_NONE))
+				throw std::runtime_error("The encoder does not report any supported sample format.");
+			sample_fmt        = _codec->sample_fmts[0];
+			sample_fmt_source = AV_SAMPLE_FMT_FLTP;
+		}
+
+		// Down-mix to the largest supported layout if the encoder can't take the OBS layout.
+		uint64_t layout_source = ffmpeg::tools::obs_speakerlayout_to_avchannellayout(aoi->speakers);
+		uint64_t layout        = layout_source;
+		if (_codec->channel_layouts) {
+			bool is_supported = false;
+			for (auto ptr = _codec->channel_layouts; *ptr != 0; ptr++) {
+				if (*ptr == layout_source)
+					is_supported = true;
+			}
+			if (!is_supported) {
+				int channels = av_get_channel_layout_nb_channels(layout_source);
+				layout       = _codec->channel_layouts[0];
+				for (auto ptr = _codec->channel_layouts; *ptr != 0; ptr++) {
+					int have = av_get_channel_layout_nb_channels(layout);
+					int next = av_get_channel_layout_nb_channels(*ptr);
+					if ((next <= channels) && ((have > channels) || (next > have)))
+						layout = *ptr;
+				}
+			}
+		}
+
+		// Use the closest supported sample rate, OBS resamples to whatever get_audio_info reports.
+		int sample_rate = static_cast<int>(aoi->samples_per_sec);
+		if (_codec->supported_samplerates) {
+			int best = 0;
+			for (auto ptr = _codec->supported_samplerates; *ptr != 0; ptr++) {
+				if ((best == 0) || (std::abs(*ptr - sample_rate) < std::abs(best - sample_rate)))
+					best = *ptr;
+			}
+			sample_rate = best;
+		}
+
+		_context->sample_fmt     = sample_fmt;
+		_context->sample_rate    = sample_rate;
+		_context->channel_layout = layout;
+		_context->channels       = av_get_channel_layout_nb_channels(_context->channel_layout);
+		_context->time_base.num  = 1;
+		_context->time_base.den  = sample_rate;
+
+		// OBS resamples already, so the sample count is the same on both sides of the conversion.
+		_swresample.set_source(layout_source, sample_fmt_source, sample_rate);
+		_swresample.set_target(layout, sample_fmt, sample_rate);
+		if (!_swresample.initialize()) {
+			std::stringstream sstr;
+			sstr << "Initializing resampler failed for conversion from '"
+			     << av_get_sample_fmt_name(_swresample.get_source_format()) << "' with "
+			     << av_get_channel_layout_nb_channels(_swresample.get_source_layout()) << " channels to '"
+			     << av_get_sample_fmt_name(_swresample.get_target_format()) << "' with "
+			     << av_get_channel_layout_nb_channels(_swresample.get_target_layout()) << " channels.";
+			throw std::runtime_error(sstr.str());
+		}
 	}
 }
 
@@ -702,6 +1025,24 @@ void obsffmpeg::encoder::initialize_hw(obs_data_t*)
 #endif
 
 	_context->hw_device_ctx = _hwinst->create_device_context();
+	if (!_context->hw_device_ctx) {
+		// Backends without a device (system memory) hand over software frames.
+		_context->pix_fmt = _context->sw_pix_fmt;
+		return;
+	}
+
+	// Hardware frame pools are tied to the graphics device, which OBS shares with every encoder.
+	{
+		auto gctx = obsffmpeg::obs_graphics();
+		_device   = gs_get_device_obj();
+	}
+	obsffmpeg::resources res;
+	if (obsffmpeg::resource_cache::acquire(get_resource_key(0), res)) {
+		PLOG_DEBUG("[%s] Reusing hardware frame pool of a previous encoder.", _codec->name);
+		_context->hw_frames_ctx = res.hw_frames;
+		_free_frames.swap(res.frames);
+		return;
+	}
 
 	_context->hw_frames_ctx = av_hwframe_ctx_alloc(_context->hw_device_ctx);
 	if (!_context->hw_frames_ctx)
@@ -717,6 +1058,29 @@ void obsffmpeg::encoder::initialize_hw(obs_data_t*)
 		throw std::runtime_error("Failed to initialize AVHWFramesContext.");
 }
 
+obsffmpeg::resource_key obsffmpeg::encoder::get_resource_key(int flags)
+{
+	obsffmpeg::resource_key key = {};
+	key.device                  = _device;
+	if (_hwinst) {
+		key.source_width  = key.target_width  = static_cast<uint32_t>(_context->width);
+		key.source_height = key.target_height = static_cast<uint32_t>(_context->height);
+		key.source_format                     = _context->sw_pix_fmt;
+		key.target_format                     = _context->pix_fmt;
+	} else {
+		key.source_width  = _swscale.get_source_width();
+		key.source_height = _swscale.get_source_height();
+		key.source_format = _swscale.get_source_format();
+		key.target_width  = _swscale.get_target_width();
+		key.target_height = _swscale.get_target_height();
+		key.target_format = _swscale.get_target_format();
+	}
+	key.colorspace = _context->colorspace;
+	key.full_range = (_context->color_range == AVCOL_RANGE_JPEG);
+	key.flags      = flags;
+	return key;
+}
+
 void obsffmpeg::encoder::push_free_frame(std::shared_ptr<AVFrame> frame)
 {
 	auto now = std::chrono::high_resolution_clock::now();
@@ -746,13 +1110,17 @@ std::shared_ptr<AVFrame> obsffmpeg::encoder::pop_free_frame()
 				av_frame_free(&frame);
 			});
 
-			frame->width  = _context->width;
-			frame->height = _context->height;
-			frame->format = _context->pix_fmt;
+			// Audio frames are given their buffers in audio_encode. Video frames take the size and format
+			// from the scaler, since the context may still be opening.
+			if (_codec->type == AVMEDIA_TYPE_VIDEO) {
+				frame->width  = static_cast<int>(_swscale.get_target_width());
+				frame->height = static_cast<int>(_swscale.get_target_height());
+				frame->format = _swscale.get_target_format();
 
-			int res = av_frame_get_buffer(frame.get(), 32);
-			if (res < 0) {
-				throw std::runtime_error(ffmpeg::tools::get_error_description(res));
+				int res = av_frame_get_buffer(frame.get(), 32);
+				if (res < 0) {
+					throw std::runtime_error(ffmpeg::tools::get_error_description(res));
+				}
 			}
 		}
 	}
@@ -772,114 +1140,612 @@ std::shared_ptr<AVFrame> obsffmpeg::encoder::pop_used_frame()
 	return frame;
 }
 
-obsffmpeg::encoder::encoder(obs_data_t* settings, obs_encoder_t* encoder, bool is_texture_encode)
-    : _self(encoder), _factory(reinterpret_cast<encoder_factory*>(obs_encoder_get_type_data(_self))),
-      _codec(_factory->get_avcodec()), _context(nullptr), _lag_in_frames(0), _count_send_frames(0),
-      _have_first_frame(false)
+void obsffmpeg::encoder::reserve_packet_room(AVPacket& packet)
 {
-	// Find a handler
-	_handler = obsffmpeg::find_codec_handler(_codec->name);
-
-	// Initialize GPU Stuff
-	if (is_texture_encode) {
-#ifdef WIN32
-		auto gctx = obsffmpeg::obs_graphics();
-		if (gs_get_device_type() == GS_DEVICE_DIRECT3D_11) {
-			_hwapi = std::make_shared<obsffmpeg::hwapi::d3d11>();
+	if ((_packet_headroom == 0) && (_packet_tailroom == 0))
+		return;
+
+	// Buffers from the encoder are often larger than the packet. The AV_INPUT_BUFFER_PADDING_SIZE bytes of
+	// zeros behind the data are not usable room, they have to stay behind the data once it grew.
+	if (packet.buf && av_buffer_is_writable(packet.buf)) {
+		size_t head = static_cast<size_t>(packet.data - packet.buf->data);
+		size_t tail = static_cast<size_t>(packet.buf->size) - head - static_cast<size_t>(packet.size);
+		if ((head >= _packet_headroom) && (tail >= _packet_tailroom + AV_INPUT_BUFFER_PADDING_SIZE)) {
+			std::memset(packet.data + packet.size, 0, _packet_tailroom + AV_INPUT_BUFFER_PADDING_SIZE);
+			return;
 		}
-#endif
-		_hwinst = _hwapi->create_from_obs();
 	}
 
+	// Otherwise move the data into a pooled buffer that has the requested room.
+	size_t size = _packet_headroom + static_cast<size_t>(packet.size) + _packet_tailroom
+	              + AV_INPUT_BUFFER_PADDING_SIZE;
+	if (!_packet_pool || (size > _packet_pool_size)) {
+		// Outstanding buffers keep the old pool alive until they are returned.
+		av_buffer_pool_uninit(&_packet_pool);
+		_packet_pool_size = size + size / 4;
+		_packet_pool      = av_buffer_pool_init(static_cast<int>(_packet_pool_size), nullptr);
+		if (!_packet_pool)
+			throw std::bad_alloc();
+	}
+
+	AVBufferRef* buf = av_buffer_pool_get(_packet_pool);
+	if (!buf)
+		throw std::bad_alloc();
+
+	uint8_t* data = buf->data + _packet_headroom;
+	std::memcpy(data, packet.data, packet.size);
+	std::memset(data + packet.size, 0, _packet_tailroom + AV_INPUT_BUFFER_PADDING_SIZE);
+
+	av_buffer_unref(&packet.buf);
+	packet.buf  = buf;
+	packet.data = data;
+}
+
+void obsffmpeg::encoder::create_context(obs_data_t* settings)
+{
 	// Initialize context.
-	_context = avcodec_alloc_context3(_codec);
+	{
+		BENCHMARK_SCOPE("encoder.alloc_context", _codec->name);
+		_context = avcodec_alloc_context3(_codec);
+	}
 	if (!_context) {
 		PLOG_ERROR("Failed to create context for encoder '%s'.", _codec->name);
 		throw std::runtime_error("failed to create context");
 	}
 
-	// Create 8MB of precached Packet data for use later on.
-	av_init_packet(&_current_packet);
-	av_new_packet(&_current_packet, 8 * 1024 * 1024); // 8 MB precached Packet size.
+	// Ask the handler how much room it needs around packets for post-processing.
+	if (_handler)
+		_handler->get_packet_room(_codec, _context, _packet_headroom, _packet_tailroom);
 
-	if (is_texture_encode) {
+	if (_hwinst) {
+		BENCHMARK_SCOPE("encoder.initialize_hw", _codec->name);
 		initialize_hw(settings);
 	} else {
+		BENCHMARK_SCOPE("encoder.initialize_sw", _codec->name);
 		initialize_sw(settings);
 	}
 
 	// Update settings
-	update(settings);
+	{
+		BENCHMARK_SCOPE("encoder.update", _codec->name);
+		update(settings);
+	}
 
-	// Initialize Encoder
-	auto gctx = obsffmpeg::obs_graphics();
-	int  res  = avcodec_open2(_context, _codec, NULL);
+	// Overload Governor
+	if (!_hwinst && (_codec->type == AVMEDIA_TYPE_VIDEO)) {
+		if (!_governor) {
+			auto mode =
+			    static_cast<obsffmpeg::governor::mode>(obs_data_get_int(settings, ST_FFMPEG_GOVERNOR));
+			if (mode != obsffmpeg::governor::mode::DISABLED) {
+				uint8_t* preset = nullptr;
+				av_opt_get(_context->priv_data, "preset", 0, &preset);
+				_governor = std::make_unique<obsffmpeg::governor>(
+				    mode, preset ? reinterpret_cast<const char*>(preset) : "", _context->width,
+				    _context->height, av_q2d(_context->time_base));
+				av_free(preset);
+				PLOG_INFO("[%s] Overload governor has %zu levels.", _codec->name,
+				          _governor->get_level_count());
+			}
+		} else {
+			apply_governor_level();
+		}
+	}
+
+	// Realtime Policy
+	_drop_late_frames =
+	    (_codec->type == AVMEDIA_TYPE_VIDEO) && obs_data_get_bool(settings, ST_FFMPEG_DROPLATEFRAMES);
+	_realtime.set_interval(av_q2d(_context->time_base));
+
+	_frames_since_open = 0;
+
+	// Thread Policy, applied to the threads started for software video encoders.
+	if (!_hwinst && (_codec->type == AVMEDIA_TYPE_VIDEO)) {
+		_thread_policy.cpus  = obs_data_get_string(settings, ST_FFMPEG_AFFINITY);
+		_thread_policy.nice  = static_cast<int>(obs_data_get_int(settings, ST_FFMPEG_PRIORITY));
+		_thread_policy.batch = obs_data_get_bool(settings, ST_FFMPEG_BATCHSCHEDULING);
+	}
+
+#ifdef ENABLE_OUT_OF_PROCESS
+	// Out of Process, the context here only describes the encoder that the host opens.
+	if (!_hwinst && (_codec->type == AVMEDIA_TYPE_VIDEO) && obs_data_get_bool(settings, ST_FFMPEG_OUTOFPROCESS)) {
+		int size = av_image_get_buffer_size(_context->pix_fmt, _context->width, _context->height, 32);
+		if (size <= 0)
+			throw std::runtime_error("Unable to determine frame size for the encoder host.");
+		_remote = std::make_shared<obsffmpeg::remote_encoder>(static_cast<size_t>(size),
+		                                                       obsffmpeg::get_global_config(), _thread_policy);
+	}
+#endif
+
+	// Parallel Encoding, frames of intra-only encoders are spread one by one, everything else in whole GOPs.
+	if (!_hwinst && !_remote && (_codec->type == AVMEDIA_TYPE_VIDEO)) {
+		int64_t count  = obs_data_get_int(settings, ST_FFMPEG_PARALLEL);
+		int     length = ffmpeg::tools::is_intra_only(_codec) ? 1 : _context->gop_size;
+		if ((count > 1) && (length > 0))
+			_parallel = std::make_unique<obsffmpeg::parallel_encoder>(
+			    static_cast<size_t>(count), static_cast<size_t>(length), _thread_policy);
+	}
+
+	// Software video encoders can take seconds to open, so they may be opened in the background while the
+	// first frames are buffered. Hardware encoders need the graphics context and audio encoders are needed for
+	// their headers right away, both are opened here.
+	if (!_hwinst && (_codec->type == AVMEDIA_TYPE_VIDEO) && obs_data_get_bool(settings, ST_FFMPEG_ASYNCOPEN)) {
+		_open_done   = false;
+		_open_thread = std::thread([this]() {
+			apply_thread_policy();
+			try {
+				open_context(_settings);
+			} catch (const std::exception& ex) {
+				_open_error = ex.what();
+			}
+			_open_done = true;
+		});
+	} else if (!_hwinst && !_thread_policy.is_default()) {
+		// The policy must not change the thread of OBS, so the encoder is opened on a thread of its own.
+		std::string error;
+		std::thread opener([this, settings, &error]() {
+			apply_thread_policy();
+			try {
+				open_context(settings);
+			} catch (const std::exception& ex) {
+				error = ex.what();
+			}
+		});
+		opener.join();
+		if (error.size() > 0)
+			throw std::runtime_error(error);
+		_open_done = true;
+	} else {
+		auto gctx = obsffmpeg::obs_graphics(!!_hwinst);
+		open_context(settings);
+		_open_done = true;
+	}
+}
+
+void obsffmpeg::encoder::open_context(obs_data_t* settings)
+{
+	// Bitstream Filters are parsed before opening, a bad chain is ignored instead of failing the encoder.
+	{
+		const char* filters = obs_data_get_string(settings, ST_FFMPEG_BITSTREAMFILTERS);
+		_bsf.finalize();
+		if (filters && (strnlen(filters, 65535) > 0)) {
+			try {
+				_bsf.parse(filters);
+			} catch (const std::exception& ex) {
+				PLOG_WARNING("[%s] Ignoring bitstream filters: %s", _codec->name, ex.what());
+			}
+		}
+	}
+
+	int res = 0;
+	{
+		BENCHMARK_SCOPE("encoder.open", _codec->name);
+		if (_remote) {
+#ifdef ENABLE_OUT_OF_PROCESS
+			res = _remote->open(_context, &_open_options);
+#endif
+		} else if (_parallel) {
+			res = _parallel->open(_context, &_open_options);
+		} else {
+			res = avcodec_open2(_context, _codec, &_open_options);
+			if (res >= 0)
+				obsffmpeg::thread_pool::install(_context);
+		}
+	}
+	{
+		AVDictionaryEntry* entry = nullptr;
+		while ((entry = av_dict_get(_open_options, "", entry, AV_DICT_IGNORE_SUFFIX)) != nullptr) {
+			PLOG_WARNING("[%s] Option '%s' with value '%s' was not used by the encoder.", _codec->name,
+			             entry->key, entry->value);
+		}
+		av_dict_free(&_open_options);
+	}
 	if (res < 0) {
 		std::stringstream sstr;
 		sstr << "Initializing encoder '" << _codec->name
 		     << "' failed with error: " << ffmpeg::tools::get_error_description(res) << " (code " << res << ")";
 		throw std::runtime_error(sstr.str());
 	}
+	if (_parallel)
+		PLOG_INFO("[%s] Encoding on %zu contexts in parallel, %zu frames each.", _codec->name,
+		          _parallel->get_count(), _parallel->get_segment_length());
+
+	// Audio encoders create their headers while opening, and OBS asks for them before the first packet.
+	if ((_codec->type == AVMEDIA_TYPE_AUDIO) && (_context->extradata != nullptr)) {
+		_extra_data.resize(_context->extradata_size);
+		std::memcpy(_extra_data.data(), _context->extradata, _context->extradata_size);
+	}
+
+	// Initialize Bitstream Filters
+	if (_bsf.is_parsed()) {
+		try {
+			_bsf.initialize(_context);
+		} catch (const std::exception& ex) {
+			PLOG_WARNING("[%s] Ignoring bitstream filters: %s", _codec->name, ex.what());
+		}
+	}
+
+	// Only now the open itself was measured, which may have happened in the background.
+	BENCHMARK_REPORT("encoder.");
 }
 
-obsffmpeg::encoder::~encoder()
+void obsffmpeg::encoder::apply_thread_policy()
 {
-	auto gctx = obsffmpeg::obs_graphics();
+	// Threads that the encoder starts while opening inherit the policy from the thread that opens it.
+	if (!_thread_policy.is_default() && !_thread_policy.apply())
+		PLOG_WARNING("[%s] Failed to apply affinity or priority to the encoder threads.", _codec->name);
+}
+
+bool obsffmpeg::encoder::wait_for_open()
+{
+	if (_open_thread.joinable())
+		_open_thread.join();
+
+	if (_open_error.size() > 0) {
+		PLOG_ERROR("[%s] %s", _codec->name, _open_error.c_str());
+		return false;
+	}
+	return true;
+}
+
+static size_t get_frame_bytes(const AVFrame* frame)
+{
+	size_t bytes = 0;
+	for (size_t idx = 0; idx < AV_NUM_DATA_POINTERS; idx++) {
+		if (frame->buf[idx])
+			bytes += static_cast<size_t>(frame->buf[idx]->size);
+	}
+	return bytes;
+}
+
+bool obsffmpeg::encoder::buffer_startup_frame(encoder_frame* frame, int64_t pts)
+{
+	std::shared_ptr<AVFrame> vframe = pop_free_frame();
+	if (!convert_video_frame(frame, vframe.get())) {
+		push_free_frame(vframe);
+		return false;
+	}
+	vframe->pts = pts;
+
+	size_t bytes = get_frame_bytes(vframe.get());
+	if ((_startup_bytes + bytes) > STARTUP_BYTES_MAX) {
+		if (_startup_dropped == 0)
+			PLOG_WARNING("[%s] More than %d MB of frames wait for the encoder, dropping frames until it "
+			             "caught up.",
+			             _codec->name, STARTUP_BYTES_MAX / (1024 * 1024));
+		_startup_dropped++;
+		push_free_frame(vframe);
+		return true;
+	}
+	_startup_bytes += bytes;
+	_startup_frames.push(vframe);
+	return true;
+}
+
+bool obsffmpeg::encoder::submit_startup_frames()
+{
+	// At least one frame per call keeps the buffer from growing, more while the call takes less than a frame
+	// makes it shrink. What the encoder returns queues up behind older packets, see video_encode.
+	auto begin    = std::chrono::high_resolution_clock::now();
+	auto interval = std::chrono::duration<double>(av_q2d(_context->time_base));
+	do {
+		std::shared_ptr<AVFrame> vframe = _startup_frames.front();
+		_startup_frames.pop();
+		_startup_bytes -= std::min(_startup_bytes, get_frame_bytes(vframe.get()));
+
+		// Timestamps were kept as they are, the rest of the frame could only be filled in once the context was
+		// open. Buffered frames are late by design, giving up on them would only lose them.
+		prepare_video_frame(vframe.get(), vframe->pts);
+		if (!encode_queued(vframe, std::chrono::high_resolution_clock::time_point::max()))
+			return false;
+		_frames_since_open++;
+	} while ((_startup_frames.size() > 0) && ((std::chrono::high_resolution_clock::now() - begin) < interval));
+
+	if ((_startup_frames.size() == 0) && (_startup_dropped > 0)) {
+		PLOG_WARNING("[%s] Caught up with the buffered frames, %llu frames were lost.", _codec->name,
+		             _startup_dropped);
+		_startup_dropped = 0;
+	}
+	return true;
+}
+
+void obsffmpeg::encoder::destroy_context(bool keep_packets)
+{
+	if (_open_thread.joinable())
+		_open_thread.join();
+	while (_startup_frames.size() > 0)
+		_startup_frames.pop();
+	_startup_bytes   = 0;
+	_startup_dropped = 0;
+
+	auto gctx = obsffmpeg::obs_graphics(!!_hwinst);
 	if (_context) {
-		// Flush encoders that require it.
-		if ((_codec->capabilities & AV_CODEC_CAP_DELAY) != 0) {
-			avcodec_send_frame(_context, nullptr);
-			while (avcodec_receive_packet(_context, &_current_packet) >= 0) {
-				avcodec_send_frame(_context, nullptr);
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		// Flush encoders that require it, remote and parallel encoders are simply stopped unless their packets
+		// are needed.
+		bool delayed = ((_codec->capabilities & AV_CODEC_CAP_DELAY) != 0) || _parallel || _bsf.is_active();
+		if (delayed && (keep_packets || (!_remote && !_parallel))) {
+			codec_send_frame(nullptr);
+			if (keep_packets) {
+				encoder_packet packet   = {0};
+				bool           received = false;
+				while (receive_packet(&received, &packet) == 0) {
+					queue_current_packet();
+				}
+			} else {
+				while (codec_receive_packet(&_current_packet) >= 0) {
+					codec_send_frame(nullptr);
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
 			}
 		}
 
-		// Close and free context.
+		// Close and free context, the copies of it first.
+		_parallel.reset();
 		avcodec_close(_context);
 		avcodec_free_context(&_context);
 	}
+	_remote.reset();
 
-	av_packet_unref(&_current_packet);
+	_bsf.finalize();
+}
+
+void obsffmpeg::encoder::reopen_context()
+{
+	const governor_level& level = _governor->get_level();
+	PLOG_INFO("[%s] Reopening at governor level %zu: preset '%s', %ux%u, every %u. frame.", _codec->name,
+	          _governor->get_level_index(), level.preset.c_str(), level.width, level.height, level.fps_divider);
 
+	destroy_context(true);
 	_swscale.finalize();
+
+	// Frames in the pool may have the old size.
+	while (_free_frames.size() > 0)
+		_free_frames.pop();
+	while (_used_frames.size() > 0)
+		_used_frames.pop();
+
+	create_context(_settings);
+	_timestamp_check = true;
 }
 
-void obsffmpeg::encoder::get_properties(obs_properties_t* props, bool hw_encode)
+void obsffmpeg::encoder::apply_governor_level()
 {
-	if (_handler)
-		_handler->get_properties(props, _codec, _context, hw_encode);
+	const governor_level& level = _governor->get_level();
 
-	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES), false);
-	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES_INTERVALTYPE), false);
-	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES_INTERVAL_SECONDS), false);
-	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES_INTERVAL_FRAMES), false);
+	if (level.preset.size() > 0)
+		av_opt_set(_context->priv_data, "preset", level.preset.c_str(), 0);
 
-	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_COLORFORMAT), false);
-	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_THREADS), false);
-	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_STANDARDCOMPLIANCE), false);
-	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_GPU), false);
+	if ((level.width != static_cast<uint32_t>(_context->width))
+	    || (level.height != static_cast<uint32_t>(_context->height))) {
+		_context->width  = static_cast<int>(level.width);
+		_context->height = static_cast<int>(level.height);
+
+		_swscale.finalize();
+		_swscale.set_target_size(level.width, level.height);
+		if (!_swscale.initialize(SWS_BILINEAR))
+			throw std::runtime_error("Failed to initialize scaler for the governor.");
+
+		// Frames taken over from a previous encoder have the size of the source.
+		while (_free_frames.size() > 0)
+			_free_frames.pop();
+	}
+
+	// Frames are skipped in video_encode, the time base stays the same. Keyframe intervals in seconds were
+	// turned into frames at the full rate, so they have to shrink with it. Bitrates are per second and stay.
+	if (level.fps_divider > 1) {
+		_context->framerate.den *= static_cast<int>(level.fps_divider);
+		if (_handler && _handler->has_keyframe_support(this) && (_context->gop_size > 0)
+		    && (obs_data_get_int(_settings, S_KEYFRAMES_INTERVALTYPE) == 0)) {
+			_context->gop_size   = std::max(1, _context->gop_size / static_cast<int>(level.fps_divider));
+			_context->keyint_min = std::max(1, _context->keyint_min / static_cast<int>(level.fps_divider));
+		}
+	}
 }
 
-bool obsffmpeg::encoder::update(obs_data_t* settings)
+obsffmpeg::encoder::encoder(obs_data_t* settings, obs_encoder_t* encoder, bool is_texture_encode,
+                            encoder_factory* factory)
+    : _self(encoder),
+      _factory(factory ? factory : reinterpret_cast<encoder_factory*>(obs_encoder_get_type_data(_self))),
+      _codec(_factory->get_avcodec()), _context(nullptr), _settings(settings), _device(nullptr),
+      _open_options(nullptr), _packet_headroom(0), _packet_tailroom(0), _packet_pool(nullptr), _packet_pool_size(0),
+      _lag_in_frames(0), _count_send_frames(0), _have_first_frame(false), _audio_zero_copy(false),
+      _audio_zero_copy_tested(false), _governor_pending(false), _frames_since_open(0), _frame_index(0),
+      _last_dts(AV_NOPTS_VALUE), _timestamp_offset(0), _timestamp_check(false), _drop_late_frames(false),
+      _keyframe_requested(false), _open_done(false), _startup_bytes(0), _startup_dropped(0), _hw_errors(0)
 {
-	// FFmpeg Options
-	_context->debug                 = 0;
-	_context->strict_std_compliance = static_cast<int>(obs_data_get_int(settings, ST_FFMPEG_STANDARDCOMPLIANCE));
+	obs_data_addref(_settings);
+#ifdef WIN32
+	_failover_stage = nullptr;
+#endif
 
-	/// Threading
-	if (!_hwinst) {
-		_context->thread_type = 0;
-		if (_codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) {
-			_context->thread_type |= FF_THREAD_FRAME;
-		}
-		if (_codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) {
-			_context->thread_type |= FF_THREAD_SLICE;
-		}
+	// Find a handler
+	_handler = obsffmpeg::find_codec_handler(_codec->name);
+
+	// Initialize GPU Stuff
+	if (is_texture_encode) {
+#ifdef WIN32
+		auto gctx = obsffmpeg::obs_graphics();
+		if (gs_get_device_type() == GS_DEVICE_DIRECT3D_11) {
+			_hwapi = std::make_shared<obsffmpeg::hwapi::d3d11>();
+		}
+#else
+		// Without Direct3D 11 textures are handed over in system memory.
+		_hwapi = std::make_shared<obsffmpeg::hwapi::system>();
+#endif
+		if (!_hwapi)
+			throw obsffmpeg::unsupported_gpu_exception("no hardware api for this graphics device");
+		_hwinst = _hwapi->create_from_obs();
+#ifdef ENABLE_FAULT_INJECTION
+		_hwinst = obsffmpeg::hwapi::fault_instance::wrap(_hwinst, obsffmpeg::get_global_config());
+#endif
+	}
+
+	// Create 8MB of precached Packet data for use later on.
+	av_init_packet(&_current_packet);
+	av_new_packet(&_current_packet, 8 * 1024 * 1024); // 8 MB precached Packet size.
+	av_init_packet(&_pending_packet);
+	_pending_packet.data = nullptr;
+	_pending_packet.size = 0;
+
+	create_context(settings);
+
+	// Share a worker with the other audio tracks.
+	if ((_codec->type == AVMEDIA_TYPE_AUDIO)
+	    && obsffmpeg::audio_batch::is_enabled(obsffmpeg::get_global_config())) {
+		_audio_batch = obsffmpeg::audio_batch::get(obs_encoder_audio(_self));
+		_audio_batch->join(this);
+	}
+}
+
+obsffmpeg::encoder::~encoder()
+{
+	if (_audio_batch) {
+		_audio_batch->leave(this);
+		_audio_batch.reset();
+	}
+	obsffmpeg::cpu_budget::release(this);
+#ifdef WIN32
+	if (_failover_stage) {
+		auto gctx = obsffmpeg::obs_graphics();
+		gs_stagesurface_destroy(_failover_stage);
+	}
+#endif
+
+	// Keep what a new encoder with the same conversion can use.
+	obsffmpeg::resources res;
+	obsffmpeg::resource_key key = {};
+	if (_context && (_codec->type == AVMEDIA_TYPE_VIDEO)) {
+		key = get_resource_key(_swscale.get_flags());
+		if (_context->hw_frames_ctx)
+			res.hw_frames = av_buffer_ref(_context->hw_frames_ctx);
+	}
+
+	destroy_context(false);
+
+	res.scaler = _swscale.release();
+	if (res.scaler || res.hw_frames) {
+		while (_used_frames.size() > 0)
+			push_free_frame(pop_used_frame());
+		res.frames.swap(_free_frames);
+		obsffmpeg::resource_cache::release(key, res);
+	} else {
+		av_buffer_unref(&res.hw_frames);
+	}
+
+	if (_realtime.get_dropped() > 0)
+		PLOG_INFO("[%s] Dropped %llu frames in total to keep up with real time.", _codec->name,
+		          _realtime.get_dropped());
+
+	while (_pending_packets.size() > 0) {
+		_free_packets.push(_pending_packets.front());
+		_pending_packets.pop();
+	}
+	while (_free_packets.size() > 0) {
+		av_packet_free(&_free_packets.top());
+		_free_packets.pop();
+	}
+	av_packet_unref(&_pending_packet);
+	av_packet_unref(&_current_packet);
+	av_buffer_pool_uninit(&_packet_pool);
+	av_dict_free(&_open_options);
+
+	_swscale.finalize();
+	_swresample.finalize();
+	obs_data_release(_settings);
+}
+
+void obsffmpeg::encoder::get_properties(obs_properties_t* props, bool hw_encode)
+{
+	if (_handler)
+		_handler->get_properties(props, _codec, _context, hw_encode);
+
+	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES), false);
+	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES_INTERVALTYPE), false);
+	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES_INTERVAL_SECONDS), false);
+	obs_property_set_enabled(obs_properties_get(props, S_KEYFRAMES_INTERVAL_FRAMES), false);
+
+	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_COLORFORMAT), false);
+	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_THREADS), false);
+	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_STANDARDCOMPLIANCE), false);
+	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_GPU), false);
+	obs_property_set_enabled(obs_properties_get(props, ST_FFMPEG_BITSTREAMFILTERS), false);
+}
+
+bool obsffmpeg::encoder::update(obs_data_t* settings)
+{
+	// A context that is still opening in the background has to finish first.
+	if (_open_thread.joinable() && !wait_for_open())
+		return false;
+
+	if (_failover)
+		return _failover->update(settings);
+
+	// The context of an encoder host can't be changed after it was sent, nor the copies of parallel contexts.
+	if (_remote || _parallel) {
+		PLOG_DEBUG("[%s] Ignoring changes to an out of process or parallel encoder.", _codec->name);
+		return true;
+	}
+
+	// An open context ignores most changes, only apply what the encoder can reconfigure on the fly.
+	if (avcodec_is_open(_context)) {
+		if (_handler && _handler->has_dynamic_bitrate_support(_codec)) {
+			_handler->reconfigure(settings, _codec, _context);
+			PLOG_INFO("[%s] Reconfigured to %lli kbit/s (maximum %lli kbit/s, buffer %i kbit).", _codec->name,
+			          _context->bit_rate / 1000, _context->rc_max_rate / 1000, _context->rc_buffer_size / 1000);
+		}
+		return true;
+	}
+
+	// FFmpeg Options
+	_context->debug                 = 0;
+	_context->strict_std_compliance = static_cast<int>(obs_data_get_int(settings, ST_FFMPEG_STANDARDCOMPLIANCE));
+
+	/// Frame Rate, a target rate takes precedence over the divider.
+	if (_codec->type == AVMEDIA_TYPE_VIDEO) {
+		AVRational  source  = _context->framerate;
+		AVRational  target  = source;
+		int64_t     divider = obs_data_get_int(settings, ST_FFMPEG_FRAMERATEDIVIDER);
+		const char* rate    = obs_data_get_string(settings, ST_FFMPEG_FRAMERATE);
+		if (rate && (rate[0] != '\0')) {
+			if (av_parse_video_rate(&target, rate) < 0) {
+				PLOG_WARNING("[%s] Ignoring invalid frame rate '%s'.", _codec->name, rate);
+				target = source;
+			}
+		} else if (divider > 1) {
+			target.den *= static_cast<int>(divider);
+		}
+		av_reduce(&target.num, &target.den, target.num, target.den, std::numeric_limits<int>::max());
+
+		_rate_divider.setup(source, target);
+		if (_rate_divider.is_active()) {
+			_context->framerate = _rate_divider.get_target();
+			_context->time_base = av_inv_q(_context->framerate);
+		}
+	}
+
+	/// Threading
+	if (!_hwinst) {
+		_context->thread_type = 0;
+		if (_codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) {
+			_context->thread_type |= FF_THREAD_FRAME;
+		}
+		if (_codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) {
+			_context->thread_type |= FF_THREAD_SLICE;
+		}
 		if (_context->thread_type != 0) {
 			int64_t threads = obs_data_get_int(settings, ST_FFMPEG_THREADS);
 			if (threads > 0) {
 				_context->thread_count = static_cast<int>(threads);
+			} else if ((_codec->type == AVMEDIA_TYPE_VIDEO) && obsffmpeg::cpu_budget::is_enabled()) {
+				// Share the cores with all other encoders, by the pixels per second each one encodes.
+				double rate = static_cast<double>(_context->width) * _context->height;
+				if (_context->time_base.num > 0)
+					rate *= av_q2d(av_inv_q(_context->time_base));
+				_context->thread_count = obsffmpeg::cpu_budget::assign(this, rate);
+
+				auto counters = obsffmpeg::cpu_budget::get_counters();
+				PLOG_INFO("[%s] CPU budget assigns %d of %zu cores, %zu encoders hold %zu threads.",
+				          _codec->name, _context->thread_count, counters.cores, counters.encoders,
+				          counters.threads);
 			} else {
 				_context->thread_count = std::thread::hardware_concurrency();
 			}
@@ -900,22 +1766,24 @@ bool obsffmpeg::encoder::update(obs_data_t* settings)
 	// Keyframes
 	if (_handler && _handler->has_keyframe_support(this)) {
 		// Key-Frame Options
-		obs_video_info ovi;
-		if (!obs_get_video_info(&ovi)) {
-			throw std::runtime_error(
-			    "obs_get_video_info failed, restart OBS Studio to fix it (hopefully).");
-		}
-
 		int64_t kf_type    = obs_data_get_int(settings, S_KEYFRAMES_INTERVALTYPE);
 		bool    is_seconds = (kf_type == 0);
 
 		if (is_seconds) {
+			// Frame rate of the context, lower than the one of OBS Studio if frames are skipped.
 			_context->gop_size = static_cast<int>(
-			    obs_data_get_double(settings, S_KEYFRAMES_INTERVAL_SECONDS) * (ovi.fps_num / ovi.fps_den));
+			    obs_data_get_double(settings, S_KEYFRAMES_INTERVAL_SECONDS) * av_q2d(_context->framerate));
 		} else {
 			_context->gop_size = static_cast<int>(obs_data_get_int(settings, S_KEYFRAMES_INTERVAL_FRAMES));
 		}
 		_context->keyint_min = _context->gop_size;
+
+		// Requested keyframes are marked as I pictures, some encoders only make an IDR of them when asked to.
+		if (ffmpeg::tools::has_private_option(_codec, "forced-idr"))
+			av_opt_set_int(_context->priv_data, "forced-idr", 1, 0);
+		if (ffmpeg::tools::has_private_option(_codec, "intra-refresh"))
+			av_opt_set_int(_context->priv_data, "intra-refresh",
+			               obs_data_get_bool(settings, S_KEYFRAMES_INTRAREFRESH) ? 1 : 0, 0);
 	}
 
 	// Handler Options
@@ -925,8 +1793,20 @@ bool obsffmpeg::encoder::update(obs_data_t* settings)
 	{ // FFmpeg Custom Options
 		const char* opts     = obs_data_get_string(settings, ST_FFMPEG_CUSTOMSETTINGS);
 		size_t      opts_len = strnlen(opts, 65535);
-
-		parse_ffmpeg_commandline(std::string{opts, opts + opts_len});
+		_custom_options      = _factory->get_option_set(std::string{opts, opts + opts_len});
+
+		// Apply them right away so that handler overrides can see them, and hand them to avcodec_open2 again
+		// for the options which are only read while opening. Values rejected here would fail the open.
+		av_dict_free(&_open_options);
+		_open_options = _custom_options->create_dictionary();
+		for (auto& kv : _custom_options->get_options()) {
+			int res = av_opt_set(_context, kv.first.c_str(), kv.second.c_str(), AV_OPT_SEARCH_CHILDREN);
+			if (res < 0) {
+				PLOG_WARNING("Option '%s' with value '%s' encountered error: %s", kv.first.c_str(),
+				             kv.second.c_str(), ffmpeg::tools::get_error_description(res));
+				av_dict_set(&_open_options, kv.first.c_str(), nullptr, 0);
+			}
+		}
 	}
 
 	// Handler Overrides
@@ -939,43 +1819,58 @@ bool obsffmpeg::encoder::update(obs_data_t* settings)
 		PLOG_INFO("[%s]   FFmpeg:", _codec->name);
 		PLOG_INFO("[%s]     Custom Settings: %s", _codec->name,
 		          obs_data_get_string(settings, ST_FFMPEG_CUSTOMSETTINGS));
+		PLOG_INFO("[%s]     Bitstream Filters: %s", _codec->name,
+		          obs_data_get_string(settings, ST_FFMPEG_BITSTREAMFILTERS));
 		PLOG_INFO("[%s]     Standard Compliance: %s", _codec->name,
 		          ffmpeg::tools::get_std_compliance_name(_context->strict_std_compliance));
 		PLOG_INFO("[%s]     Threading: %s (with %i threads)", _codec->name,
 		          ffmpeg::tools::get_thread_type_name(_context->thread_type), _context->thread_count);
 
-		PLOG_INFO("[%s]   Video:", _codec->name);
-		if (_hwinst) {
-			PLOG_INFO("[%s]     Texture: %ldx%ld %s %s %s", _codec->name, _context->width, _context->height,
-			          ffmpeg::tools::get_pixel_format_name(_context->sw_pix_fmt),
-			          ffmpeg::tools::get_color_space_name(_context->colorspace),
-			          av_color_range_name(_context->color_range));
-		} else {
-			PLOG_INFO("[%s]     Input: %ldx%ld %s %s %s", _codec->name, _swscale.get_source_width(),
-			          _swscale.get_source_height(),
-			          ffmpeg::tools::get_pixel_format_name(_swscale.get_source_format()),
-			          ffmpeg::tools::get_color_space_name(_swscale.get_source_colorspace()),
-			          _swscale.is_source_full_range() ? "Full" : "Partial");
-			PLOG_INFO("[%s]     Output: %ldx%ld %s %s %s", _codec->name, _swscale.get_target_width(),
-			          _swscale.get_target_height(),
-			          ffmpeg::tools::get_pixel_format_name(_swscale.get_target_format()),
-			          ffmpeg::tools::get_color_space_name(_swscale.get_target_colorspace()),
-			          _swscale.is_target_full_range() ? "Full" : "Partial");
-			if (!_hwinst)
-				PLOG_INFO("[%s]     On GPU Index: %lli", _codec->name,
-				          obs_data_get_int(settings, ST_FFMPEG_GPU));
-		}
-		PLOG_INFO("[%s]     Framerate: %ld/%ld (%f FPS)", _codec->name, _context->time_base.den,
-		          _context->time_base.num,
-		          static_cast<double_t>(_context->time_base.den)
-		              / static_cast<double_t>(_context->time_base.num));
-
-		PLOG_INFO("[%s]   Keyframes: ", _codec->name);
-		if (_context->keyint_min != _context->gop_size) {
-			PLOG_INFO("[%s]     Minimum: %i frames", _codec->name, _context->keyint_min);
-			PLOG_INFO("[%s]     Maximum: %i frames", _codec->name, _context->gop_size);
+		if (_codec->type == AVMEDIA_TYPE_AUDIO) {
+			PLOG_INFO("[%s]   Audio:", _codec->name);
+			PLOG_INFO("[%s]     Input: %s with %i channels", _codec->name,
+			          av_get_sample_fmt_name(_swresample.get_source_format()),
+			          av_get_channel_layout_nb_channels(_swresample.get_source_layout()));
+			PLOG_INFO("[%s]     Output: %s with %i channels", _codec->name,
+			          av_get_sample_fmt_name(_context->sample_fmt), _context->channels);
+			PLOG_INFO("[%s]     Sample Rate: %i Hz", _codec->name, _context->sample_rate);
 		} else {
-			PLOG_INFO("[%s]     Distance: %i frames", _codec->name, _context->gop_size);
+			PLOG_INFO("[%s]   Video:", _codec->name);
+			if (_hwinst) {
+				PLOG_INFO("[%s]     Texture: %ldx%ld %s %s %s", _codec->name, _context->width,
+				          _context->height,
+				          ffmpeg::tools::get_pixel_format_name(_context->sw_pix_fmt),
+				          ffmpeg::tools::get_color_space_name(_context->colorspace),
+				          av_color_range_name(_context->color_range));
+			} else {
+				PLOG_INFO("[%s]     Input: %ldx%ld %s %s %s", _codec->name,
+				          _swscale.get_source_width(), _swscale.get_source_height(),
+				          ffmpeg::tools::get_pixel_format_name(_swscale.get_source_format()),
+				          ffmpeg::tools::get_color_space_name(_swscale.get_source_colorspace()),
+				          _swscale.is_source_full_range() ? "Full" : "Partial");
+				PLOG_INFO("[%s]     Output: %ldx%ld %s %s %s", _codec->name,
+				          _swscale.get_target_width(), _swscale.get_target_height(),
+				          ffmpeg::tools::get_pixel_format_name(_swscale.get_target_format()),
+				          ffmpeg::tools::get_color_space_name(_swscale.get_target_colorspace()),
+				          _swscale.is_target_full_range() ? "Full" : "Partial");
+				if (!_hwinst)
+					PLOG_INFO("[%s]     On GPU Index: %lli", _codec->name,
+					          obs_data_get_int(settings, ST_FFMPEG_GPU));
+			}
+			PLOG_INFO("[%s]     Framerate: %ld/%ld (%f FPS)", _codec->name,
+			          _context->time_base.den, _context->time_base.num,
+			          static_cast<double_t>(_context->time_base.den)
+			              / static_cast<double_t>(_context->time_base.num));
+
+			PLOG_INFO("[%s]   Keyframes: ", _codec->name);
+			if (_context->keyint_min != _context->gop_size) {
+				PLOG_INFO("[%s]     Minimum: %i frames", _codec->name, _context->keyint_min);
+				PLOG_INFO("[%s]     Maximum: %i frames", _codec->name, _context->gop_size);
+			} else {
+				PLOG_INFO("[%s]     Distance: %i frames", _codec->name, _context->gop_size);
+			}
+			if (ffmpeg::tools::has_private_option(_codec, "intra-refresh"))
+				ffmpeg::tools::print_av_option_bool(_context, "intra-refresh", "    Intra Refresh");
 		}
 		_handler->log_options(settings, _codec, _context);
 	}
@@ -983,16 +1878,121 @@ bool obsffmpeg::encoder::update(obs_data_t* settings)
 	return true;
 }
 
-void obsffmpeg::encoder::get_audio_info(audio_convert_info*) {}
+void obsffmpeg::encoder::get_audio_info(audio_convert_info* info)
+{
+	info->format          = ffmpeg::tools::avsampleformat_to_obs_audioformat(_swresample.get_source_format());
+	info->samples_per_sec = static_cast<uint32_t>(_context->sample_rate);
+}
 
 size_t obsffmpeg::encoder::get_frame_size()
 {
-	return size_t();
+	// OBS buffers audio into frames of exactly this size, so frames never need to be split or merged here.
+	// Encoders with a variable frame size report 0, which OBS can't buffer with, so they get the AAC size.
+	if (_context->frame_size > 0)
+		return static_cast<size_t>(_context->frame_size);
+	return 1024;
 }
 
-bool obsffmpeg::encoder::audio_encode(encoder_frame*, encoder_packet*, bool*)
+static void no_free(void*, uint8_t*) {}
+
+static inline void fill_encoder_packet(encoder_packet* packet, AVPacket& source, obs_encoder_type type)
 {
-	return false;
+	packet->type          = type;
+	packet->pts           = source.pts;
+	packet->dts           = source.dts;
+	packet->data          = source.data;
+	packet->size          = source.size;
+	packet->keyframe      = !!(source.flags & AV_PKT_FLAG_KEY);
+	packet->drop_priority = packet->keyframe ? 0 : 1;
+}
+
+bool obsffmpeg::encoder::audio_encode(encoder_frame* frame, encoder_packet* packet, bool* received_packet)
+{
+	// Retrieve an empty frame, batched frames come from the pool of the batch.
+	std::shared_ptr<AVFrame> aframe = _audio_batch ? _audio_batch->acquire_frame() : pop_free_frame();
+
+	// If OBS delivers exactly what the encoder wants, its planes can be handed over as they are.
+	// They are only valid during this call, which is fine as long as the encoder consumes frames while they
+	// are sent. The first frame is copied to find out whether it does, and every later frame is checked again,
+	// see below. Batched frames are encoded after this call returned, so they are always copied.
+	bool zero_copy = !_audio_batch && _audio_zero_copy && _swresample.is_passthrough();
+	if (zero_copy || (aframe->nb_samples != static_cast<int>(frame->frames))
+	    || (aframe->format != _context->sample_fmt) || (aframe->channel_layout != _context->channel_layout))
+		av_frame_unref(aframe.get());
+
+	aframe->format         = _context->sample_fmt;
+	aframe->channel_layout = _context->channel_layout;
+	aframe->channels       = _context->channels;
+	aframe->sample_rate    = _context->sample_rate;
+	aframe->nb_samples     = static_cast<int>(frame->frames);
+	aframe->pts            = frame->pts;
+
+	if (zero_copy) {
+		int planes   = av_sample_fmt_is_planar(_context->sample_fmt) ? _context->channels : 1;
+		int linesize = 0;
+		av_samples_get_buffer_size(&linesize, _context->channels, aframe->nb_samples, _context->sample_fmt, 1);
+		for (int idx = 0; idx < planes; idx++) {
+			aframe->data[idx] = frame->data[idx];
+			aframe->buf[idx] =
+			    av_buffer_create(frame->data[idx], linesize, no_free, nullptr, AV_BUFFER_FLAG_READONLY);
+			if (!aframe->buf[idx])
+				throw std::bad_alloc();
+		}
+		aframe->linesize[0]   = linesize;
+		aframe->extended_data = aframe->data;
+	} else {
+		int res = aframe->buf[0] ? av_frame_make_writable(aframe.get()) : av_frame_get_buffer(aframe.get(), 0);
+		if (res < 0) {
+			PLOG_ERROR("Failed to allocate audio frame: %s (%ld).",
+			           ffmpeg::tools::get_error_description(res), res);
+			return false;
+		}
+		if (_swresample.is_passthrough()) {
+			av_samples_copy(aframe->extended_data, frame->data, 0, 0, aframe->nb_samples,
+			                _context->channels, _context->sample_fmt);
+		} else {
+			res = _swresample.convert(frame->data, aframe->nb_samples, aframe->extended_data,
+			                          aframe->nb_samples);
+			if (res < 0) {
+				PLOG_ERROR("Failed to convert audio: %s (%ld).",
+				           ffmpeg::tools::get_error_description(res), res);
+				return false;
+			}
+		}
+	}
+
+	if (_audio_batch) {
+		_audio_batch->submit(this, aframe);
+
+		// OBS takes a single packet per call, so the worker must not fall behind by more than this frame.
+		// Otherwise the packets it finishes late would stay queued for good.
+		_audio_batch->wait_for_previous(this, std::chrono::milliseconds(100));
+		if (pop_pending_packet(packet))
+			*received_packet = true;
+		return true;
+	}
+
+	if (!encode_avframe(aframe, packet, received_packet,
+	                    std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(50)))
+		return false;
+
+	if (_swresample.is_passthrough()) {
+		// An encoder that still holds a reference kept the frame for later, OBS's planes can't be used there.
+		// Encoders with delay may only start doing so later on, so they always copy.
+		bool held = (av_buffer_get_ref_count(aframe->buf[0]) > 1);
+		if (!_audio_zero_copy_tested) {
+			_audio_zero_copy        = !held && ((_codec->capabilities & AV_CODEC_CAP_DELAY) == 0);
+			_audio_zero_copy_tested = true;
+			PLOG_DEBUG("[%s] Audio frames are %s.", _codec->name,
+			           _audio_zero_copy ? "handed over directly" : "copied");
+		} else if (held && _audio_zero_copy) {
+			_audio_zero_copy = false;
+			PLOG_WARNING("[%s] Encoder kept an audio frame, audio frames are copied from now on.",
+			             _codec->name);
+		}
+	}
+
+	return true;
 }
 
 void obsffmpeg::encoder::get_video_info(video_scale_info* vsi)
@@ -1014,6 +2014,10 @@ bool obsffmpeg::encoder::get_sei_data(uint8_t** data, size_t* size)
 
 bool obsffmpeg::encoder::get_extra_data(uint8_t** data, size_t* size)
 {
+	// The headers are only known once the context is open, outputs ask for them from their own thread.
+	while (!_open_done)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
 	if (_extra_data.size() == 0)
 		return false;
 
@@ -1052,43 +2056,129 @@ static inline void copy_data(encoder_frame* frame, AVFrame* vframe)
 	}
 }
 
-bool obsffmpeg::encoder::video_encode(encoder_frame* frame, encoder_packet* packet, bool* received_packet)
+void obsffmpeg::encoder::prepare_video_frame(AVFrame* vframe, int64_t pts)
 {
-	std::shared_ptr<AVFrame> vframe = pop_free_frame(); // Retrieve an empty frame.
+	vframe->color_range     = _context->color_range;
+	vframe->colorspace      = _context->colorspace;
+	vframe->color_primaries = _context->color_primaries;
+	vframe->color_trc       = _context->color_trc;
+	vframe->pts             = pts;
+	apply_keyframe_request(vframe);
+}
 
-	// Convert frame.
-	{
+bool obsffmpeg::encoder::convert_video_frame(encoder_frame* frame, AVFrame* vframe)
+{
 #ifdef _DEBUG
-		ScopeProfiler profile("convert");
+	ScopeProfiler profile("convert");
 #endif
 
-		vframe->height          = _context->height;
-		vframe->format          = _context->pix_fmt;
-		vframe->color_range     = _context->color_range;
-		vframe->colorspace      = _context->colorspace;
-		vframe->color_primaries = _context->color_primaries;
-		vframe->color_trc       = _context->color_trc;
-		vframe->pts             = frame->pts;
-
-		if ((_swscale.is_source_full_range() == _swscale.is_target_full_range())
-		    && (_swscale.get_source_colorspace() == _swscale.get_target_colorspace())
-		    && (_swscale.get_source_format() == _swscale.get_target_format())) {
-			copy_data(frame, vframe.get());
-		} else {
-			int res = _swscale.convert(reinterpret_cast<uint8_t**>(frame->data),
-			                           reinterpret_cast<int*>(frame->linesize), 0, _context->height,
-			                           vframe->data, vframe->linesize);
-			if (res <= 0) {
-				PLOG_ERROR("Failed to convert frame: %s (%ld).",
-				           ffmpeg::tools::get_error_description(res), res);
-				return false;
-			}
+	// Size and format come from the scaler, which matches the context but is never touched while it opens.
+	vframe->width  = static_cast<int>(_swscale.get_target_width());
+	vframe->height = static_cast<int>(_swscale.get_target_height());
+	vframe->format = _swscale.get_target_format();
+
+	if ((_swscale.is_source_full_range() == _swscale.is_target_full_range())
+	    && (_swscale.get_source_colorspace() == _swscale.get_target_colorspace())
+	    && (_swscale.get_source_format() == _swscale.get_target_format())
+	    && (_swscale.get_source_size() == _swscale.get_target_size())) {
+		copy_data(frame, vframe);
+	} else {
+		int res = _swscale.convert(reinterpret_cast<uint8_t**>(frame->data),
+		                           reinterpret_cast<int*>(frame->linesize), 0, _swscale.get_source_height(),
+		                           vframe->data, vframe->linesize);
+		if (res <= 0) {
+			PLOG_ERROR("Failed to convert frame: %s (%ld).", ffmpeg::tools::get_error_description(res),
+			           res);
+			return false;
 		}
 	}
+	return true;
+}
+
+bool obsffmpeg::encoder::video_encode(encoder_frame* frame, encoder_packet* packet, bool* received_packet)
+{
+	// Frames that a lower frame rate leaves out are not converted at all.
+	int64_t pts = 0;
+	if (!_rate_divider.select(frame->pts, pts)) {
+		if (_pending_packets.size() > 0)
+			*received_packet = pop_pending_packet(packet);
+		return true;
+	}
 
-	if (!encode_avframe(vframe, packet, received_packet))
+	// Apply a pending governor decision where the encoder would place a keyframe anyway. Decisions are only
+	// made for encoded frames, so the context is open here.
+	if (_governor_pending && ((_context->gop_size <= 0) || ((_frames_since_open % _context->gop_size) == 0))) {
+		_governor_pending = false;
+		reopen_context();
+	}
+
+	// The context belongs to avcodec_open2 while it opens in the background, so frames are only converted and
+	// held until then. Timestamps are kept as they are.
+	if (!_open_done) {
+		if (!buffer_startup_frame(frame, pts))
+			return false;
+		*received_packet = pop_pending_packet(packet);
+		return true;
+	}
+	if ((_open_thread.joinable() || (_open_error.size() > 0)) && !wait_for_open())
 		return false;
 
+	auto encode_begin = std::chrono::high_resolution_clock::now();
+	bool skip_frame   = _governor && ((_frame_index % _governor->get_level().fps_divider) != 0);
+	_frame_index++;
+
+	// Frames held while opening are older than this one, so it is held behind them while the encoder catches up.
+	// OBS takes a single packet per call, packets queue up meanwhile and the stream is delayed by the time the
+	// open took instead of losing frames.
+	if (_startup_frames.size() > 0) {
+		if (!skip_frame && !buffer_startup_frame(frame, pts))
+			return false;
+		if (!submit_startup_frames())
+			return false;
+		*received_packet = pop_pending_packet(packet);
+		return true;
+	}
+
+	// Give up on frames that arrive too late to be useful, but never on the one that starts a new GOP.
+	bool keyframe = is_keyframe_due();
+	if (!skip_frame && _drop_late_frames && _realtime.should_drop(pts, keyframe)) {
+		count_dropped_frame();
+		skip_frame = true;
+	}
+
+	if (!skip_frame) {
+		std::shared_ptr<AVFrame> vframe = pop_free_frame(); // Retrieve an empty frame.
+		if (!convert_video_frame(frame, vframe.get())) {
+			push_free_frame(vframe);
+			return false;
+		}
+		prepare_video_frame(vframe.get(), pts);
+
+		// Packets flushed from a replaced context are older, so new packets queue up behind them. The new
+		// context returns nothing until its lookahead is filled, which is when the old packets go out.
+		if (_pending_packets.size() > 0) {
+			if (!encode_queued(vframe, get_frame_deadline(pts, keyframe)))
+				return false;
+			*received_packet = pop_pending_packet(packet);
+		} else if (!encode_avframe(vframe, packet, received_packet, get_frame_deadline(pts, keyframe))) {
+			return false;
+		}
+		_frames_since_open++;
+
+		// Only frames that were encoded tell the governor anything about the encoder.
+		if (_governor && _governor->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		                                 std::chrono::high_resolution_clock::now() - encode_begin))) {
+			const governor_level& level = _governor->get_level();
+			PLOG_INFO("[%s] Governor moved to level %zu: preset '%s', %ux%u, every %u. frame.",
+			          _codec->name, _governor->get_level_index(), level.preset.c_str(), level.width,
+			          level.height, level.fps_divider);
+			_governor_pending = true;
+		}
+	} else {
+		// Calls without a frame to encode are where queued packets catch up.
+		*received_packet = pop_pending_packet(packet);
+	}
+
 	return true;
 }
 
@@ -1101,32 +2191,268 @@ bool obsffmpeg::encoder::video_encode_texture(uint32_t handle, int64_t pts, uint
 		return false;
 	}
 
+	if (_failover)
+		return failover_encode_texture(handle, pts, lock_key, next_lock_key, packet, received_packet);
+
+	// Textures that a lower frame rate leaves out are not copied at all.
+	int64_t target_pts = 0;
+	if (!_rate_divider.select(pts, target_pts)) {
+		*next_lock_key = lock_key;
+		return true;
+	}
+
+	bool keyframe = is_keyframe_due();
+	if (_drop_late_frames && _realtime.should_drop(target_pts, keyframe)) {
+		count_dropped_frame();
+		*next_lock_key = lock_key;
+		return true;
+	}
+
 	std::shared_ptr<AVFrame> vframe = pop_free_frame();
-	_hwinst->copy_from_obs(_context->hw_frames_ctx, handle, lock_key, next_lock_key, vframe);
+	try {
+		_hwinst->copy_from_obs(_context->hw_frames_ctx, handle, lock_key, next_lock_key, vframe);
+	} catch (const std::exception& ex) {
+		push_free_frame(vframe);
+		*next_lock_key = lock_key;
+		return handle_hardware_error(ex.what());
+	}
 
 	vframe->color_range     = _context->color_range;
 	vframe->colorspace      = _context->colorspace;
 	vframe->color_primaries = _context->color_primaries;
 	vframe->color_trc       = _context->color_trc;
-	vframe->pts             = pts;
+	vframe->pts             = target_pts;
+	apply_keyframe_request(vframe.get());
 
-	if (!encode_avframe(vframe, packet, received_packet))
+	*next_lock_key = lock_key;
+	if (!encode_avframe(vframe, packet, received_packet, get_frame_deadline(target_pts, keyframe)))
+		return handle_hardware_error("Failed to encode frame.");
+	_frames_since_open++;
+	_hw_errors = 0;
+
+	return true;
+}
+
+bool obsffmpeg::encoder::handle_hardware_error(const char* reason)
+{
+	_hw_errors++;
+	count_dropped_frame();
+	PLOG_WARNING("[%s] Hardware error %zu of %d: %s", _codec->name, _hw_errors, FAILOVER_ERRORS, reason);
+	if (_hw_errors < FAILOVER_ERRORS)
+		return true;
+
+	// Continue with the software encoder that FFmpeg prefers for the same codec, with the same settings. Its
+	// first frame is a keyframe, and timestamps are shifted if needed so that DTS keeps increasing.
+	auto factory = obsffmpeg::find_software_encoder_factory(_codec->id);
+	if (!factory) {
+		PLOG_ERROR("[%s] No software encoder to switch to after %d hardware errors in a row.", _codec->name,
+		           FAILOVER_ERRORS);
+		return false;
+	}
+	PLOG_WARNING("[%s] Switching to '%s' after %d hardware errors in a row.", _codec->name,
+	             factory->get_avcodec()->name, FAILOVER_ERRORS);
+	// Options only the software encoder has are missing from the settings, so start from its defaults.
+	obs_data_t* settings = obs_data_create();
+	factory->get_defaults(settings, false);
+	obs_data_apply(settings, _settings);
+	try {
+		_failover = std::make_unique<obsffmpeg::encoder>(settings, _self, false, factory.get());
+	} catch (const std::exception& ex) {
+		PLOG_ERROR("[%s] Failed to create software encoder: %s", _codec->name, ex.what());
+		obs_data_release(settings);
 		return false;
+	}
+	obs_data_release(settings);
 
-	*next_lock_key = lock_key;
+	// Flush the hardware encoder, its packets go out before those of the software encoder. Everything that
+	// belongs to the failing device is released afterwards.
+	destroy_context(true);
+	{
+		auto gctx = obsffmpeg::obs_graphics();
+		while (_free_frames.size() > 0)
+			_free_frames.pop();
+		while (_used_frames.size() > 0)
+			_used_frames.pop();
+		_hwinst.reset();
+		_hwapi.reset();
+	}
 
+	_hw_errors       = 0;
+	_timestamp_check = true;
 	return true;
 }
 
+void obsffmpeg::encoder::download_obs_texture(uint32_t handle, uint64_t lock_key, uint64_t* next_lock_key)
+{
+	auto voi = video_output_get_info(obs_encoder_video(_self));
+	if (!_failover_frame) {
+		_failover_frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
+			av_frame_unref(frame);
+			av_frame_free(&frame);
+		});
+		_failover_frame->width  = static_cast<int>(voi->width);
+		_failover_frame->height = static_cast<int>(voi->height);
+		_failover_frame->format = ffmpeg::tools::obs_videoformat_to_avpixelformat(voi->format);
+		int res                 = av_frame_get_buffer(_failover_frame.get(), 32);
+		if (res < 0)
+			throw std::runtime_error(ffmpeg::tools::get_error_description(res));
+	}
+
+#ifdef WIN32
+	// OBS shares NV12 textures only, and stages them with the chroma plane right below the luma plane.
+	if (voi->format != VIDEO_FORMAT_NV12)
+		throw std::runtime_error("Only NV12 textures can be read back.");
+
+	auto gctx = obsffmpeg::obs_graphics();
+	if (!_failover_stage) {
+		_failover_stage = gs_stagesurface_create_nv12(voi->width, voi->height);
+		if (!_failover_stage)
+			throw std::runtime_error("Failed to create staging surface.");
+	}
+
+	gs_texture_t* texture = gs_texture_open_shared(handle);
+	if (!texture)
+		throw std::runtime_error("Failed to open shared texture.");
+	if (gs_texture_acquire_sync(texture, lock_key, 1000) != 0) {
+		gs_texture_destroy(texture);
+		throw std::runtime_error("Failed to acquire lock on input texture.");
+	}
+	gs_stage_texture(_failover_stage, texture);
+	gs_texture_release_sync(texture, lock_key);
+	gs_texture_destroy(texture);
+
+	uint8_t* data     = nullptr;
+	uint32_t linesize = 0;
+	if (!gs_stagesurface_map(_failover_stage, &data, &linesize))
+		throw std::runtime_error("Failed to map staging surface.");
+	av_image_copy_plane(_failover_frame->data[0], _failover_frame->linesize[0], data, static_cast<int>(linesize),
+	                    static_cast<int>(voi->width), static_cast<int>(voi->height));
+	av_image_copy_plane(_failover_frame->data[1], _failover_frame->linesize[1], data + linesize * voi->height,
+	                    static_cast<int>(linesize), static_cast<int>(voi->width),
+	                    static_cast<int>(voi->height / 2));
+	gs_stagesurface_unmap(_failover_stage);
+#else
+	// Without Direct3D 11 the textures are surfaces in system memory already.
+	auto surface = obsffmpeg::hwapi::system::find_surface(handle);
+	if (!surface)
+		throw std::runtime_error("Failed to find surface for handle.");
+	if (!surface->acquire(lock_key, std::chrono::milliseconds(1000)))
+		throw std::runtime_error("Failed to acquire lock on input surface.");
+	int res = av_frame_copy(_failover_frame.get(), surface->get_frame().get());
+	surface->release(lock_key);
+	if (res < 0)
+		throw std::runtime_error("Failed to copy input surface.");
+#endif
+}
+
+bool obsffmpeg::encoder::failover_encode_texture(uint32_t handle, int64_t pts, uint64_t lock_key,
+                                                 uint64_t* next_lock_key, encoder_packet* packet,
+                                                 bool* received_packet)
+{
+	if (_keyframe_requested.exchange(false))
+		_failover->request_keyframe();
+
+	try {
+		download_obs_texture(handle, lock_key, next_lock_key);
+	} catch (const std::exception& ex) {
+		*next_lock_key = lock_key;
+		count_dropped_frame();
+		PLOG_WARNING("[%s] Failed to read back texture for software encoding: %s", _codec->name, ex.what());
+		*received_packet = pop_pending_packet(packet);
+		return (++_hw_errors < FAILOVER_ERRORS);
+	}
+	*next_lock_key = lock_key;
+	_hw_errors     = 0;
+
+	encoder_frame frame = {};
+	for (size_t idx = 0; idx < MAX_AV_PLANES; idx++) {
+		frame.data[idx]     = _failover_frame->data[idx];
+		frame.linesize[idx] = static_cast<uint32_t>(_failover_frame->linesize[idx]);
+	}
+	frame.frames = 1;
+	frame.pts    = pts;
+
+	// Packets flushed from the hardware encoder are older, so those of the software encoder queue up behind
+	// them until they are gone, see video_encode.
+	if (_pending_packets.size() == 0) {
+		bool ok = _failover->video_encode(&frame, packet, received_packet);
+		if (ok && *received_packet)
+			adjust_timestamps(packet->pts, packet->dts);
+		return ok;
+	}
+
+	encoder_packet queued   = {};
+	bool           received = false;
+	bool           ok       = _failover->video_encode(&frame, &queued, &received);
+	if (ok && received) {
+		adjust_timestamps(queued.pts, queued.dts);
+		av_packet_unref(&_current_packet);
+		if (av_new_packet(&_current_packet, static_cast<int>(queued.size)) < 0)
+			throw std::bad_alloc();
+		std::memcpy(_current_packet.data, queued.data, queued.size);
+		_current_packet.pts   = queued.pts;
+		_current_packet.dts   = queued.dts;
+		_current_packet.flags = queued.keyframe ? AV_PKT_FLAG_KEY : 0;
+		queue_current_packet();
+	}
+	*received_packet = pop_pending_packet(packet);
+	return ok;
+}
+
+void obsffmpeg::encoder::adjust_timestamps(int64_t& pts, int64_t& dts)
+{
+	// A new encoder may start with a larger reorder delay than the previous one, which would make DTS go
+	// backwards. Shift the new stream just enough to keep it increasing.
+	if (_timestamp_check) {
+		_timestamp_offset = 0;
+		if ((_last_dts != AV_NOPTS_VALUE) && (dts <= _last_dts))
+			_timestamp_offset = _last_dts + 1 - dts;
+		if (_timestamp_offset != 0)
+			PLOG_DEBUG("[%s] Shifting timestamps by %lld after switching encoders.", _codec->name,
+			           _timestamp_offset);
+		_timestamp_check = false;
+	}
+	pts += _timestamp_offset;
+	dts += _timestamp_offset;
+	_last_dts = dts;
+}
+
 int obsffmpeg::encoder::receive_packet(bool* received_packet, struct encoder_packet* packet)
 {
 	int res = 0;
 
 	av_packet_unref(&_current_packet);
 
-	{
-		auto gctx = obsffmpeg::obs_graphics();
-		res       = avcodec_receive_packet(_context, &_current_packet);
+	// Packets still held by the bitstream filters have priority over new packets from the encoder.
+	res = _bsf.is_active() ? _bsf.receive_packet(&_current_packet) : AVERROR(EAGAIN);
+	while (res == AVERROR(EAGAIN)) {
+		{
+			auto gctx = obsffmpeg::obs_graphics(!!_hwinst);
+			res       = codec_receive_packet(&_current_packet);
+		}
+		if ((res == AVERROR_EOF) && _bsf.is_active() && !_bsf.is_flushed()) {
+			// The encoder is drained, now drain the packets that the filters still hold.
+			_bsf.flush();
+			res = _bsf.receive_packet(&_current_packet);
+			continue;
+		}
+		if (res != 0) {
+			return res;
+		}
+
+		// The encoder is done with the oldest frame, regardless of what the filters do with the packet.
+		if (_used_frames.size() > 0)
+			push_free_frame(pop_used_frame());
+
+		if (!_bsf.is_active())
+			break;
+
+		res = _bsf.send_packet(&_current_packet);
+		if (res < 0) {
+			PLOG_ERROR("Failed to filter packet: %s (%ld).", ffmpeg::tools::get_error_description(res), res);
+			return res;
+		}
+		res = _bsf.receive_packet(&_current_packet);
 	}
 	if (res != 0) {
 		return res;
@@ -1162,6 +2488,10 @@ int obsffmpeg::encoder::receive_packet(bool* received_packet, struct encoder_pac
 		} else if (_codec->id == AV_CODEC_ID_HEVC) {
 			obsffmpeg::codecs::hevc::extract_header_sei(_current_packet.data, _current_packet.size,
 			                                            _extra_data, _sei_data);
+		} else if (_bsf.is_active() && (_bsf.get_output_parameters()->extradata != nullptr)) {
+			const AVCodecParameters* par = _bsf.get_output_parameters();
+			_extra_data.resize(par->extradata_size);
+			std::memcpy(_extra_data.data(), par->extradata, par->extradata_size);
 		} else if (_context->extradata != nullptr) {
 			_extra_data.resize(_context->extradata_size);
 			std::memcpy(_extra_data.data(), _context->extradata, _context->extradata_size);
@@ -1170,19 +2500,19 @@ int obsffmpeg::encoder::receive_packet(bool* received_packet, struct encoder_pac
 	}
 
 	// Allow Handler Post-Processing
-	if (_handler)
+	if (_handler) {
+		reserve_packet_room(_current_packet);
 		_handler->process_avpacket(_current_packet, _codec, _context);
+	}
 
-	packet->type          = OBS_ENCODER_VIDEO;
-	packet->pts           = _current_packet.pts;
-	packet->dts           = _current_packet.dts;
-	packet->data          = _current_packet.data;
-	packet->size          = _current_packet.size;
-	packet->keyframe      = !!(_current_packet.flags & AV_PKT_FLAG_KEY);
-	packet->drop_priority = packet->keyframe ? 0 : 1;
-	*received_packet      = true;
+	// OBS Studio expects timestamps at its own frame rate.
+	_current_packet.pts = _rate_divider.to_source(_current_packet.pts);
+	_current_packet.dts = _rate_divider.to_source(_current_packet.dts);
+	adjust_timestamps(_current_packet.pts, _current_packet.dts);
 
-	push_free_frame(pop_used_frame());
+	fill_encoder_packet(packet, _current_packet,
+	                    (_codec->type == AVMEDIA_TYPE_AUDIO) ? OBS_ENCODER_AUDIO : OBS_ENCODER_VIDEO);
+	*received_packet = true;
 
 	return res;
 }
@@ -1191,8 +2521,8 @@ int obsffmpeg::encoder::send_frame(std::shared_ptr<AVFrame> const frame)
 {
 	int res = 0;
 	{
-		auto gctx = obsffmpeg::obs_graphics();
-		res       = avcodec_send_frame(_context, frame.get());
+		auto gctx = obsffmpeg::obs_graphics(!!_hwinst);
+		res       = codec_send_frame(frame.get());
 	}
 	if (res == 0) {
 		push_used_frame(frame);
@@ -1201,7 +2531,30 @@ int obsffmpeg::encoder::send_frame(std::shared_ptr<AVFrame> const frame)
 	return res;
 }
 
-bool obsffmpeg::encoder::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_packet* packet, bool* received_packet)
+int obsffmpeg::encoder::codec_send_frame(const AVFrame* frame)
+{
+#ifdef ENABLE_OUT_OF_PROCESS
+	if (_remote)
+		return _remote->send_frame(frame);
+#endif
+	if (_parallel)
+		return _parallel->send_frame(frame);
+	return avcodec_send_frame(_context, frame);
+}
+
+int obsffmpeg::encoder::codec_receive_packet(AVPacket* packet)
+{
+#ifdef ENABLE_OUT_OF_PROCESS
+	if (_remote)
+		return _remote->receive_packet(packet);
+#endif
+	if (_parallel)
+		return _parallel->receive_packet(packet);
+	return avcodec_receive_packet(_context, packet);
+}
+
+bool obsffmpeg::encoder::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_packet* packet, bool* received_packet,
+                                        std::chrono::high_resolution_clock::time_point deadline)
 {
 #ifdef _DEBUG
 	ScopeProfiler profile("loop");
@@ -1211,11 +2564,8 @@ bool obsffmpeg::encoder::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_
 	bool recv_packet = false;
 	bool should_lag  = (_count_send_frames >= _lag_in_frames);
 
-	auto loop_begin = std::chrono::high_resolution_clock::now();
-	auto loop_end   = loop_begin + std::chrono::milliseconds(50);
-
-	while ((!sent_frame || (should_lag && !recv_packet))
-	       && !(std::chrono::high_resolution_clock::now() > loop_end)) {
+	// Always try at least once, even if the deadline already passed.
+	while (!sent_frame || (should_lag && !recv_packet)) {
 		bool eagain_is_stupid = false;
 
 		if (!sent_frame) {
@@ -1265,7 +2615,8 @@ bool obsffmpeg::encoder::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_
 				if (sent_frame) {
 					recv_packet = true;
 				}
-				if (eagain_is_stupid) {
+				// Encoder hosts and parallel contexts may be busy with both and catch up by themselves.
+				if (eagain_is_stupid && !_remote && !_parallel) {
 					PLOG_ERROR("Both send and recieve returned EAGAIN, encoder is broken.");
 					return false;
 				}
@@ -1278,152 +2629,162 @@ bool obsffmpeg::encoder::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_
 		}
 
 		if (!sent_frame || !recv_packet) {
+			if (std::chrono::high_resolution_clock::now() > deadline)
+				break;
 			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
 	}
 
-	if (!sent_frame)
+	if (!sent_frame) {
 		push_free_frame(frame);
+		count_dropped_frame();
+	}
 
 	return true;
 }
 
-bool obsffmpeg::encoder::is_hardware_encode()
+bool obsffmpeg::encoder::is_keyframe_due()
 {
-	return _hwinst != nullptr;
+	return (_frames_since_open == 0) || _keyframe_requested
+	       || ((_context->gop_size > 0) && ((_frames_since_open % _context->gop_size) == 0));
 }
 
-const AVCodec* obsffmpeg::encoder::get_avcodec()
+void obsffmpeg::encoder::apply_keyframe_request(AVFrame* frame)
 {
-	return _codec;
+	// Frames are reused, so the picture type of an earlier request has to be cleared as well.
+	bool requested   = _keyframe_requested.exchange(false);
+	frame->pict_type = requested ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(58, 7, 100)
+	if (requested)
+		frame->flags |= AV_FRAME_FLAG_KEY;
+	else
+		frame->flags &= ~AV_FRAME_FLAG_KEY;
+#else
+	frame->key_frame = requested ? 1 : 0;
+#endif
 }
 
-const AVCodecContext* obsffmpeg::encoder::get_avcodeccontext()
+void obsffmpeg::encoder::request_keyframe()
 {
-	return _context;
+	_keyframe_requested = true;
 }
 
-void obsffmpeg::encoder::parse_ffmpeg_commandline(std::string text)
-{
-	// Steps to properly parse a command line:
-	// 1. Split by space and package by quotes.
-	// 2. Parse each resulting option individually.
-
-	// First, we split by space and of course respect quotes while doing so.
-	// That means that "-foo= bar" is stored as std::string("-foo= bar"),
-	//  and things like -foo="bar" is stored as std::string("-foo=\"bar\"").
-	// However "-foo"=bar" -foo2=bar" is stored as std::string("-foo=bar -foo2=bar")
-	//  because the quote was not escaped.
-	std::list<std::string> opts;
-	std::stringstream      opt_stream{std::ios_base::in | std::ios_base::out | std::ios_base::binary};
-	std::stack<char>       quote_stack;
-	for (size_t p = 0; p <= text.size(); p++) {
-		char here = p < text.size() ? text.at(p) : 0;
-
-		if (here == '\\') {
-			size_t p2 = p + 1;
-			if (p2 < text.size()) {
-				char here2 = text.at(p2);
-				if (isdigit(here2)) { // Octal
-					// Not supported yet.
-					p++;
-				} else if (here2 == 'x') { // Hexadecimal
-					// Not supported yet.
-					p += 3;
-				} else if (here2 == 'u') { // 4 or 8 wide Unicode.
-					                   // Not supported yet.
-				} else if (here2 == 'a') {
-					opt_stream << '\a';
-					p++;
-				} else if (here2 == 'b') {
-					opt_stream << '\b';
-					p++;
-				} else if (here2 == 'f') {
-					opt_stream << '\f';
-					p++;
-				} else if (here2 == 'n') {
-					opt_stream << '\n';
-					p++;
-				} else if (here2 == 'r') {
-					opt_stream << '\r';
-					p++;
-				} else if (here2 == 't') {
-					opt_stream << '\t';
-					p++;
-				} else if (here2 == 'v') {
-					opt_stream << '\v';
-					p++;
-				} else if (here2 == '\\') {
-					opt_stream << '\\';
-					p++;
-				} else if (here2 == '\'') {
-					opt_stream << '\'';
-					p++;
-				} else if (here2 == '"') {
-					opt_stream << '"';
-					p++;
-				} else if (here2 == '?') {
-					opt_stream << '\?';
-					p++;
-				}
-			}
-		} else if ((here == '\'') || (here == '"')) {
-			if (quote_stack.size() > 1) {
-				opt_stream << here;
-			}
-			if (quote_stack.size() == 0) {
-				quote_stack.push(here);
-			} else if (quote_stack.top() == here) {
-				quote_stack.pop();
-			} else {
-				quote_stack.push(here);
-			}
-		} else if ((here == 0) || ((here == ' ') && (quote_stack.size() == 0))) {
-			std::string ropt = opt_stream.str();
-			if (ropt.size() > 0) {
-				opts.push_back(ropt);
-				opt_stream.str(std::string());
-				opt_stream.clear();
-			}
-		} else {
-			opt_stream << here;
-		}
-	}
+std::chrono::high_resolution_clock::time_point obsffmpeg::encoder::get_frame_deadline(int64_t pts, bool keyframe)
+{
+	// Frames that start a new GOP are never given up on, however long the encoder takes.
+	if (keyframe)
+		return std::chrono::high_resolution_clock::time_point::max();
 
-	// Now that we have a list of parameters as neatly grouped strings, and
-	//  have also dealt with escaping for the most part. We want to parse
-	//  an FFmpeg commandline option set here, so the first character in
-	//  the string must be a '-'.
-	for (std::string& opt : opts) {
-		// Skip empty options.
-		if (opt.size() == 0)
-			continue;
+	if (!_drop_late_frames)
+		return std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(50);
+	return _realtime.get_deadline(pts);
+}
 
-		// Skip options that don't start with a '-'.
-		if (opt.at(0) != '-') {
-			PLOG_WARNING("Option '%s' is malformed, must start with a '-'.", opt.c_str());
-			continue;
-		}
+void obsffmpeg::encoder::count_dropped_frame()
+{
+	_realtime.count_drop();
 
-		// Skip options that don't contain a '='.
-		const char* cstr  = opt.c_str();
-		const char* eq_at = strchr(cstr, '=');
-		if (eq_at == nullptr) {
-			PLOG_WARNING("Option '%s' is malformed, must contain a '='.", opt.c_str());
+	uint64_t dropped = 0;
+	if (_realtime.should_report(dropped))
+		PLOG_WARNING("[%s] Dropped %llu frames to keep up with real time, %llu in total.", _codec->name,
+		             dropped, _realtime.get_dropped());
+}
+
+bool obsffmpeg::encoder::encode_queued(std::shared_ptr<AVFrame> frame,
+                                       std::chrono::high_resolution_clock::time_point deadline)
+{
+	// Older packets still wait for OBS, so everything the encoder returns queues up behind them. Taking it all
+	// out right away also keeps the encoder from refusing the next frame.
+	encoder_packet packet   = {0};
+	bool           received = false;
+	int            res      = 0;
+	while ((res = send_frame(frame)) == AVERROR(EAGAIN)) {
+		int recv = receive_packet(&received, &packet);
+		if (recv == 0) {
+			queue_current_packet();
 			continue;
 		}
+		// Encoder hosts and parallel contexts may be busy with both and catch up by themselves.
+		if ((recv != AVERROR(EAGAIN)) || (!_remote && !_parallel)
+		    || (std::chrono::high_resolution_clock::now() > deadline))
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (res == AVERROR(EAGAIN)) {
+		push_free_frame(frame);
+		count_dropped_frame();
+	} else if (res < 0) {
+		PLOG_ERROR("Failed to encode frame: %s (%ld).", ffmpeg::tools::get_error_description(res), res);
+		return false;
+	}
 
-		try {
-			std::string key   = opt.substr(1, eq_at - cstr - 1);
-			std::string value = opt.substr(eq_at - cstr + 1);
+	while (receive_packet(&received, &packet) == 0) {
+		queue_current_packet();
+	}
+	return true;
+}
 
-			int res = av_opt_set(_context, key.c_str(), value.c_str(), AV_OPT_SEARCH_CHILDREN);
-			if (res < 0) {
-				PLOG_WARNING("Option '%s' (key: '%s', value: '%s') encountered error: %s", opt.c_str(),
-				             key.c_str(), value.c_str(), ffmpeg::tools::get_error_description(res));
-			}
-		} catch (const std::exception& ex) {
-			PLOG_ERROR("Option '%s' encountered exception: %s", opt.c_str(), ex.what())
-		}
+void obsffmpeg::encoder::encode_batched(std::shared_ptr<AVFrame> frame)
+{
+	int res = avcodec_send_frame(_context, frame.get());
+	if (res < 0) {
+		PLOG_ERROR("Failed to encode frame: %s (%ld).", ffmpeg::tools::get_error_description(res), res);
+		return;
+	}
+
+	// Drain everything, so that the next frame can always be sent.
+	encoder_packet packet   = {0};
+	bool           received = false;
+	while (receive_packet(&received, &packet) == 0) {
+		queue_current_packet();
+	}
+}
+
+void obsffmpeg::encoder::queue_current_packet()
+{
+	std::lock_guard<std::mutex> lock(_pending_lock);
+
+	AVPacket* pkt = nullptr;
+	if (_free_packets.size() > 0) {
+		pkt = _free_packets.top();
+		_free_packets.pop();
+	} else {
+		pkt = av_packet_alloc();
+		if (!pkt)
+			throw std::bad_alloc();
 	}
+	av_packet_move_ref(pkt, &_current_packet);
+	_pending_packets.push(pkt);
+}
+
+bool obsffmpeg::encoder::pop_pending_packet(encoder_packet* packet)
+{
+	std::lock_guard<std::mutex> lock(_pending_lock);
+	if (_pending_packets.size() == 0)
+		return false;
+
+	AVPacket* pkt = _pending_packets.front();
+	_pending_packets.pop();
+	av_packet_unref(&_pending_packet);
+	av_packet_move_ref(&_pending_packet, pkt);
+	_free_packets.push(pkt);
+
+	fill_encoder_packet(packet, _pending_packet,
+	                    (_codec->type == AVMEDIA_TYPE_AUDIO) ? OBS_ENCODER_AUDIO : OBS_ENCODER_VIDEO);
+	return true;
+}
+
+bool obsffmpeg::encoder::is_hardware_encode()
+{
+	return _hwinst != nullptr;
+}
+
+const AVCodec* obsffmpeg::encoder::get_avcodec()
+{
+	return _codec;
+}
+
+const AVCodecContext* obsffmpeg::encoder::get_avcodeccontext()
+{
+	return _context;
 }
@@ -21,14 +21,29 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <list>
+#include <map>
 #include <mutex>
 #include <queue>
 #include <stack>
 #include <thread>
 #include <vector>
+#include "audio_batch.hpp"
+#include "codec_index.hpp"
 #include "ffmpeg/avframe-queue.hpp"
+#include "ffmpeg/bsf.hpp"
+#include "ffmpeg/option_index.hpp"
+#include "ffmpeg/option_set.hpp"
+#include "ffmpeg/swresample.hpp"
 #include "ffmpeg/swscale.hpp"
+#include "frame_rate_divider.hpp"
+#include "governor.hpp"
+#include "parallel_encoder.hpp"
+#include "realtime_policy.hpp"
+#include "resource_cache.hpp"
+#include "thread_policy.hpp"
 #include "hwapi/base.hpp"
 #include "ui/handler.hpp"
 
@@ -43,6 +58,8 @@ extern "C" {
 }
 
 namespace obsffmpeg {
+	class remote_encoder;
+
 	class unsupported_gpu_exception : public std::runtime_error {
 		public:
 		unsupported_gpu_exception(const std::string& reason) : runtime_error(reason) {}
@@ -62,10 +79,32 @@ namespace obsffmpeg {
 
 		std::shared_ptr<obsffmpeg::ui::handler> _handler;
 
+		// From the codec index, so that nothing has to be asked of FFmpeg again while loading.
+		bool _supported;
+		bool _hardware;
+		bool _unavailable;
+
+		// Readable names are only needed once OBS Studio shows the encoder.
+		std::once_flag _names_once;
+		void           build_names();
+
+		// Built on first use, most factories never show their properties.
+		std::once_flag                                    _pixel_formats_once;
+		std::list<std::pair<AVPixelFormat, std::string>> _pixel_formats;
+		std::once_flag                                    _options_once;
+		std::unique_ptr<ffmpeg::option_index>             _options;
+
+		// Compiled custom settings, keyed by the hash of their text.
+		std::mutex                                                    _option_sets_lock;
+		std::map<uint64_t, std::shared_ptr<const ffmpeg::option_set>> _option_sets;
+
 		public:
-		encoder_factory(const AVCodec* codec);
+		encoder_factory(const codec_index_entry& entry);
 		virtual ~encoder_factory();
 
+		// Flag an encoder that failed to open on this machine, must be called before register_encoder.
+		void mark_unavailable();
+
 		void register_encoder();
 
 		void get_defaults(obs_data_t* settings, bool hw_encoder = false);
@@ -74,9 +113,19 @@ namespace obsffmpeg {
 
 		const AVCodec* get_avcodec();
 
+		bool is_hardware();
+
+		bool is_unavailable();
+
 		const encoder_info& get_info();
 
 		const encoder_info& get_fallback();
+
+		const std::list<std::pair<AVPixelFormat, std::string>>& get_pixel_formats();
+
+		const ffmpeg::option_index& get_option_index();
+
+		std::shared_ptr<const ffmpeg::option_set> get_option_set(const std::string& text);
 	};
 
 	class encoder {
@@ -85,14 +134,28 @@ namespace obsffmpeg {
 
 		const AVCodec*  _codec;
 		AVCodecContext* _context;
+		obs_data_t*     _settings;
 
 		std::shared_ptr<obsffmpeg::ui::handler> _handler;
 
 		std::shared_ptr<obsffmpeg::hwapi::base>     _hwapi;
 		std::shared_ptr<obsffmpeg::hwapi::instance> _hwinst;
+		const void*                                 _device;
+
+		ffmpeg::swscale    _swscale;
+		ffmpeg::swresample _swresample;
+		ffmpeg::bsf_chain  _bsf;
+		AVPacket           _current_packet;
+
+		// Custom Settings
+		std::shared_ptr<const ffmpeg::option_set> _custom_options;
+		AVDictionary*                             _open_options;
 
-		ffmpeg::swscale _swscale;
-		AVPacket        _current_packet;
+		// Packet Room (for in-place post-processing)
+		size_t        _packet_headroom;
+		size_t        _packet_tailroom;
+		AVBufferPool* _packet_pool;
+		size_t        _packet_pool_size;
 
 		size_t _lag_in_frames;
 		size_t _count_send_frames;
@@ -102,6 +165,67 @@ namespace obsffmpeg {
 		std::vector<uint8_t> _extra_data;
 		std::vector<uint8_t> _sei_data;
 
+		// Audio
+		bool _audio_zero_copy;
+		bool _audio_zero_copy_tested;
+
+		// Batched Audio, packets are encoded by the worker of the batch and handed out one call later.
+		std::shared_ptr<obsffmpeg::audio_batch> _audio_batch;
+
+		// Pending Packets, from the batch worker or from flushing a context that is being replaced.
+		std::mutex            _pending_lock;
+		std::queue<AVPacket*> _pending_packets;
+		std::stack<AVPacket*> _free_packets;
+		AVPacket              _pending_packet;
+
+		// Overload Governor
+		std::unique_ptr<obsffmpeg::governor> _governor;
+		bool                                 _governor_pending;
+		uint64_t                             _frames_since_open;
+		uint64_t                             _frame_index;
+
+		// Frame Rate Divider, skips frames before they are converted.
+		obsffmpeg::frame_rate_divider _rate_divider;
+
+		// Keeps timestamps increasing across reopened contexts.
+		int64_t _last_dts;
+		int64_t _timestamp_offset;
+		bool    _timestamp_check;
+
+		// Realtime Policy
+		bool                       _drop_late_frames;
+		obsffmpeg::realtime_policy _realtime;
+
+		// Keyframe Request, may be set from any thread and is taken by the next frame that is encoded.
+		std::atomic<bool> _keyframe_requested;
+
+		// Affinity and scheduling of the threads started for this encoder.
+		obsffmpeg::thread_policy _thread_policy;
+
+		// Background Open, frames are buffered until the context is ready and then caught up on, together with
+		// the frames that arrive meanwhile.
+		std::thread                          _open_thread;
+		std::atomic<bool>                    _open_done;
+		std::string                          _open_error;
+		std::queue<std::shared_ptr<AVFrame>> _startup_frames;
+		size_t                               _startup_bytes;
+		uint64_t                             _startup_dropped;
+
+		// Hardware Failover, a software encoder that takes over after repeated hardware errors. Textures are
+		// then read back through OBS into a frame in system memory.
+		size_t                              _hw_errors;
+		std::unique_ptr<obsffmpeg::encoder> _failover;
+		std::shared_ptr<AVFrame>            _failover_frame;
+#ifdef WIN32
+		gs_stagesurf_t* _failover_stage;
+#endif
+
+		// Out of Process, set while the context runs in an encoder host.
+		std::shared_ptr<obsffmpeg::remote_encoder> _remote;
+
+		// Parallel Encoding, set while frames are spread over several copies of the context.
+		std::unique_ptr<obsffmpeg::parallel_encoder> _parallel;
+
 		// Frame Stack and Queue
 		std::stack<std::shared_ptr<AVFrame>>           _free_frames;
 		std::queue<std::shared_ptr<AVFrame>>           _used_frames;
@@ -110,14 +234,55 @@ namespace obsffmpeg {
 		void initialize_sw(obs_data_t* settings);
 		void initialize_hw(obs_data_t* settings);
 
+		void create_context(obs_data_t* settings);
+		void open_context(obs_data_t* settings);
+		void apply_thread_policy();
+		bool wait_for_open();
+		bool buffer_startup_frame(struct encoder_frame* frame, int64_t pts);
+		bool submit_startup_frames();
+		void destroy_context(bool keep_packets);
+		void reopen_context();
+		void apply_governor_level();
+
+		obsffmpeg::resource_key get_resource_key(int flags);
+
 		void                     push_free_frame(std::shared_ptr<AVFrame> frame);
 		std::shared_ptr<AVFrame> pop_free_frame();
 
 		void                     push_used_frame(std::shared_ptr<AVFrame> frame);
 		std::shared_ptr<AVFrame> pop_used_frame();
 
+		void reserve_packet_room(AVPacket& packet);
+
+		// Dispatch to the local context, the parallel copies of it or to the encoder host.
+		int codec_send_frame(const AVFrame* frame);
+		int codec_receive_packet(AVPacket* packet);
+
+		bool                                           is_keyframe_due();
+		void                                           apply_keyframe_request(AVFrame* frame);
+		bool                                           convert_video_frame(struct encoder_frame* frame,
+		                                                                   AVFrame*              vframe);
+		void                                           prepare_video_frame(AVFrame* vframe, int64_t pts);
+		std::chrono::high_resolution_clock::time_point get_frame_deadline(int64_t pts, bool keyframe);
+		void                                           count_dropped_frame();
+
+		void adjust_timestamps(int64_t& pts, int64_t& dts);
+
+		bool handle_hardware_error(const char* reason);
+		void download_obs_texture(uint32_t handle, uint64_t lock_key, uint64_t* next_lock_key);
+		bool failover_encode_texture(uint32_t handle, int64_t pts, uint64_t lock_key, uint64_t* next_lock_key,
+		                             struct encoder_packet* packet, bool* received_packet);
+
+		// Encode while older packets still wait for OBS, new packets are queued behind them.
+		bool encode_queued(std::shared_ptr<AVFrame>                       frame,
+		                   std::chrono::high_resolution_clock::time_point deadline);
+		void queue_current_packet();
+		bool pop_pending_packet(struct encoder_packet* packet);
+
 		public:
-		encoder(obs_data_t* settings, obs_encoder_t* encoder, bool is_texture_encode = false);
+		// The factory defaults to the one OBS created the encoder with.
+		encoder(obs_data_t* settings, obs_encoder_t* encoder, bool is_texture_encode = false,
+		        encoder_factory* factory = nullptr);
 		virtual ~encoder();
 
 		public: // OBS API
@@ -150,7 +315,14 @@ namespace obsffmpeg {
 		int send_frame(std::shared_ptr<AVFrame> frame);
 
 		bool encode_avframe(std::shared_ptr<AVFrame> frame, struct encoder_packet* packet,
-		                    bool* received_packet);
+		                    bool* received_packet, std::chrono::high_resolution_clock::time_point deadline);
+
+		// Called by the audio batch worker.
+		void encode_batched(std::shared_ptr<AVFrame> frame);
+
+		public: // Control API
+		// Encode the next frame as a keyframe, instead of waiting for the end of the keyframe interval.
+		void request_keyframe();
 
 		public: // Handler API
 		bool is_hardware_encode();
@@ -158,7 +330,5 @@ namespace obsffmpeg {
 		const AVCodec* get_avcodec();
 
 		const AVCodecContext* get_avcodeccontext();
-
-		void parse_ffmpeg_commandline(std::string text);
 	};
 } // namespace obsffmpeg
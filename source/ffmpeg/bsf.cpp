@@ -0,0 +1,121 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bsf.hpp"
+#include <sstream>
+#include <stdexcept>
+#include "tools.hpp"
+
+ffmpeg::bsf_chain::bsf_chain() {}
+
+ffmpeg::bsf_chain::~bsf_chain()
+{
+	finalize();
+}
+
+void ffmpeg::bsf_chain::parse(std::string filters)
+{
+	finalize();
+
+	int res = av_bsf_list_parse_str(filters.c_str(), &this->context);
+	if (res < 0) {
+		std::stringstream sstr;
+		sstr << "Bitstream filter chain '" << filters
+		     << "' is invalid: " << ffmpeg::tools::get_error_description(res);
+		throw std::invalid_argument(sstr.str());
+	}
+}
+
+void ffmpeg::bsf_chain::initialize(const AVCodecContext* encoder)
+{
+	if (!this->context)
+		throw std::logic_error("Bitstream filter chain was not parsed.");
+
+	int res = avcodec_parameters_from_context(this->context->par_in, encoder);
+	if (res < 0) {
+		finalize();
+		throw std::runtime_error(ffmpeg::tools::get_error_description(res));
+	}
+	this->context->time_base_in = encoder->time_base;
+
+	res = av_bsf_init(this->context);
+	if (res < 0) {
+		finalize();
+		std::stringstream sstr;
+		sstr << "Initializing bitstream filter chain failed: " << ffmpeg::tools::get_error_description(res);
+		throw std::runtime_error(sstr.str());
+	}
+	this->initialized = true;
+	this->flushed     = false;
+}
+
+void ffmpeg::bsf_chain::finalize()
+{
+	if (this->context) {
+		av_bsf_free(&this->context);
+	}
+	this->initialized = false;
+	this->flushed     = false;
+}
+
+bool ffmpeg::bsf_chain::is_parsed()
+{
+	return this->context != nullptr;
+}
+
+bool ffmpeg::bsf_chain::is_active()
+{
+	return this->initialized;
+}
+
+int ffmpeg::bsf_chain::flush()
+{
+	if (!this->initialized || this->flushed)
+		return AVERROR_EOF;
+	this->flushed = true;
+	return av_bsf_send_packet(this->context, nullptr);
+}
+
+bool ffmpeg::bsf_chain::is_flushed()
+{
+	return this->flushed;
+}
+
+const AVCodecParameters* ffmpeg::bsf_chain::get_output_parameters()
+{
+	if (!this->initialized)
+		return nullptr;
+	return this->context->par_out;
+}
+
+int ffmpeg::bsf_chain::send_packet(AVPacket* packet)
+{
+	if (!this->initialized)
+		return AVERROR(EINVAL);
+	return av_bsf_send_packet(this->context, packet);
+}
+
+int ffmpeg::bsf_chain::receive_packet(AVPacket* packet)
+{
+	if (!this->initialized)
+		return AVERROR(EAGAIN);
+	return av_bsf_receive_packet(this->context, packet);
+}
@@ -0,0 +1,63 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <string>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#pragma warning(pop)
+}
+
+namespace ffmpeg {
+	class bsf_chain {
+		AVBSFContext* context     = nullptr;
+		bool          initialized = false;
+		bool          flushed     = false;
+
+		public:
+		bsf_chain();
+		~bsf_chain();
+
+		// Parse a filter chain in FFmpeg syntax, e.g. "h264_metadata=level=4.1,filter_units=remove_types=6".
+		// Throws std::invalid_argument if the chain is invalid, before any encoder has to be opened for it.
+		void parse(std::string filters);
+
+		// Attach a parsed chain to the output of an opened encoder context.
+		void initialize(const AVCodecContext* encoder);
+		void finalize();
+
+		bool is_parsed();
+
+		bool is_active();
+
+		// Signal the end of the stream, packets that the filters held back can be received afterwards.
+		int  flush();
+		bool is_flushed();
+
+		const AVCodecParameters* get_output_parameters();
+
+		int send_packet(AVPacket* packet);
+		int receive_packet(AVPacket* packet);
+	};
+} // namespace ffmpeg
@@ -0,0 +1,252 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "option_index.hpp"
+#include <cmath>
+#include <list>
+#include <vector>
+#include "utility.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/eval.h>
+#pragma warning(pop)
+}
+
+static const char* get_option_type_name(AVOptionType type)
+{
+	switch (type) {
+	case AV_OPT_TYPE_FLAGS:
+		return "Flags";
+	case AV_OPT_TYPE_INT:
+		return "Int";
+	case AV_OPT_TYPE_INT64:
+		return "Int64";
+	case AV_OPT_TYPE_DOUBLE:
+		return "Double";
+	case AV_OPT_TYPE_FLOAT:
+		return "Float";
+	case AV_OPT_TYPE_STRING:
+		return "String";
+	case AV_OPT_TYPE_RATIONAL:
+		return "Rational";
+	case AV_OPT_TYPE_BINARY:
+		return "Binary";
+	case AV_OPT_TYPE_DICT:
+		return "Dictionary";
+	case AV_OPT_TYPE_UINT64:
+		return "Unsigned Int64";
+	case AV_OPT_TYPE_CONST:
+		return "Constant";
+	case AV_OPT_TYPE_IMAGE_SIZE:
+		return "Image Size";
+	case AV_OPT_TYPE_PIXEL_FMT:
+		return "Pixel Format";
+	case AV_OPT_TYPE_SAMPLE_FMT:
+		return "Sample Format";
+	case AV_OPT_TYPE_VIDEO_RATE:
+		return "Video Rate";
+	case AV_OPT_TYPE_DURATION:
+		return "Duration";
+	case AV_OPT_TYPE_COLOR:
+		return "Color";
+	case AV_OPT_TYPE_CHANNEL_LAYOUT:
+		return "Layout";
+	case AV_OPT_TYPE_BOOL:
+		return "Bool";
+	}
+	return "Unknown";
+}
+
+static std::string get_default_value(const AVOption* opt)
+{
+	std::vector<char> buf(32);
+	switch (opt->type) {
+	case AV_OPT_TYPE_BOOL:
+		return opt->default_val.i64 ? "true" : "false";
+	case AV_OPT_TYPE_INT:
+	case AV_OPT_TYPE_INT64:
+		snprintf(buf.data(), buf.size(), "%" PRId64, opt->default_val.i64);
+		break;
+	case AV_OPT_TYPE_UINT64:
+	case AV_OPT_TYPE_FLAGS:
+		snprintf(buf.data(), buf.size(), "%" PRIu64, static_cast<uint64_t>(opt->default_val.i64));
+		break;
+	case AV_OPT_TYPE_FLOAT:
+	case AV_OPT_TYPE_DOUBLE:
+		snprintf(buf.data(), buf.size(), "%f", opt->default_val.dbl);
+		break;
+	case AV_OPT_TYPE_STRING:
+		return opt->default_val.str ? opt->default_val.str : "";
+	default:
+		return "";
+	}
+	return std::string(buf.data());
+}
+
+static void index_class(const AVClass* cls, bool is_private, std::map<std::string, ffmpeg::option_info>& options)
+{
+	if (!cls)
+		return;
+
+	// Units are only unique within a class, so constants are resolved per class.
+	std::map<std::string, std::vector<ffmpeg::option_constant>> units;
+	std::list<std::string>                                      indexed;
+
+	const AVOption* opt = nullptr;
+	while ((opt = av_opt_next(&cls, opt)) != nullptr) {
+		if (!(opt->flags & AV_OPT_FLAG_ENCODING_PARAM))
+			continue;
+
+		if (opt->type == AV_OPT_TYPE_CONST) {
+			if (opt->unit)
+				units[opt->unit].push_back({opt->name, opt->help ? opt->help : "", opt->default_val.i64});
+			continue;
+		}
+
+		// With AV_OPT_SEARCH_CHILDREN av_opt_set finds private options first, so they win over the ones of
+		// AVCodecContext and are indexed first.
+		if (options.count(opt->name))
+			continue;
+
+		ffmpeg::option_info info;
+		info.name          = opt->name;
+		info.help          = opt->help ? opt->help : "";
+		info.unit          = opt->unit ? opt->unit : "";
+		info.type          = opt->type;
+		info.minimum       = opt->min;
+		info.maximum       = opt->max;
+		info.default_value = get_default_value(opt);
+		info.is_private    = is_private;
+		options.emplace(info.name, info);
+		indexed.push_back(info.name);
+	}
+
+	for (auto& name : indexed) {
+		auto& info = options.at(name);
+		if (info.unit.size() == 0)
+			continue;
+		auto unit = units.find(info.unit);
+		if (unit != units.end())
+			info.constants = unit->second;
+	}
+}
+
+ffmpeg::option_index::option_index(const AVCodec* codec)
+{
+	index_class(codec->priv_class, true, options);
+	index_class(avcodec_get_class(), false, options);
+}
+
+ffmpeg::option_index::~option_index() {}
+
+const std::map<std::string, ffmpeg::option_info>& ffmpeg::option_index::get_options() const
+{
+	return options;
+}
+
+const ffmpeg::option_info* ffmpeg::option_index::find(const std::string& name) const
+{
+	auto found = options.find(name);
+	if (found == options.end())
+		return nullptr;
+	return &found->second;
+}
+
+const char* ffmpeg::option_index::find_constant_name(const std::string& name, int64_t value) const
+{
+	const option_info* info = find(name);
+	if (!info)
+		return nullptr;
+	for (auto& constant : info->constants) {
+		if (constant.value == value)
+			return constant.name.c_str();
+	}
+	return nullptr;
+}
+
+bool ffmpeg::option_index::validate(const std::string& key, const std::string& value, std::string& error) const
+{
+	const option_info* info = find(key);
+	if (!info) {
+		error = "unknown option";
+		return false;
+	}
+
+	switch (info->type) {
+	case AV_OPT_TYPE_INT:
+	case AV_OPT_TYPE_INT64:
+	case AV_OPT_TYPE_UINT64:
+	case AV_OPT_TYPE_FLOAT:
+	case AV_OPT_TYPE_DOUBLE:
+		break;
+	default:
+		// Flags, booleans and complex types have their own syntax, leave those to av_opt_set.
+		return true;
+	}
+
+	double number = 0;
+	bool   found  = false;
+	for (auto& constant : info->constants) {
+		if (constant.name == value) {
+			number = static_cast<double>(constant.value);
+			found  = true;
+			break;
+		}
+	}
+	if (!found) {
+		char* tail = nullptr;
+		number     = av_strtod(value.c_str(), &tail);
+		if ((tail == value.c_str()) || (*tail != '\0')) {
+			error = "value is neither a number nor a known constant";
+			return false;
+		}
+	}
+
+	if ((number < info->minimum) || (number > info->maximum)) {
+		std::vector<char> buf(128);
+		snprintf(buf.data(), buf.size(), "value is out of range [%g, %g]", info->minimum, info->maximum);
+		error = buf.data();
+		return false;
+	}
+
+	return true;
+}
+
+void ffmpeg::option_index::log(const char* codec_name, int level) const
+{
+	PLOG(level, "Options for '%s':", codec_name);
+	for (auto& kv : options) {
+		auto& info = kv.second;
+		if (!info.is_private)
+			continue;
+
+		PLOG(level, "  Option '%s'%s%s%s with help '%s' of type '%s' with default value '%s', minimum '%g' and maximum '%g'.",
+		     info.name.c_str(), info.unit.size() ? " with unit (" : "", info.unit.c_str(),
+		     info.unit.size() ? ")" : "", info.help.c_str(), get_option_type_name(info.type),
+		     info.default_value.c_str(), info.minimum, info.maximum);
+		for (auto& constant : info.constants) {
+			PLOG(level, "    Constant '%s' and help text '%s' with value '%" PRId64 "'.", constant.name.c_str(),
+			     constant.help.c_str(), constant.value);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#pragma warning(pop)
+}
+
+namespace ffmpeg {
+	struct option_constant {
+		std::string name;
+		std::string help;
+		int64_t     value;
+	};
+
+	struct option_info {
+		std::string                  name;
+		std::string                  help;
+		std::string                  unit;
+		AVOptionType                 type;
+		double                       minimum;
+		double                       maximum;
+		std::string                  default_value;
+		bool                         is_private;
+		std::vector<option_constant> constants;
+	};
+
+	// Immutable description of all encoding options of a codec, built from the AVClass of the codec and of
+	// AVCodecContext without allocating a context.
+	class option_index {
+		std::map<std::string, option_info> options;
+
+		public:
+		option_index(const AVCodec* codec);
+		~option_index();
+
+		const std::map<std::string, option_info>& get_options() const;
+
+		const option_info* find(const std::string& name) const;
+
+		// Name of the constant with the given value, or nullptr if there is none.
+		const char* find_constant_name(const std::string& name, int64_t value) const;
+
+		// Check if av_opt_set would accept the key and value, returns false and an explanation if not.
+		bool validate(const std::string& key, const std::string& value, std::string& error) const;
+
+		void log(const char* codec_name, int level) const;
+	};
+} // namespace ffmpeg
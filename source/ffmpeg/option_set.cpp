@@ -0,0 +1,185 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "option_set.hpp"
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <stack>
+#include "utility.hpp"
+
+ffmpeg::option_set::option_set(std::string text, const option_index& index) : text(text)
+{
+	// Steps to properly parse a command line:
+	// 1. Split by space and package by quotes.
+	// 2. Parse each resulting option individually.
+
+	// First, we split by space and of course respect quotes while doing so.
+	// That means that "-foo= bar" is stored as std::string("-foo= bar"),
+	//  and things like -foo="bar" is stored as std::string("-foo=\"bar\"").
+	// However "-foo"=bar" -foo2=bar" is stored as std::string("-foo=bar -foo2=bar")
+	//  because the quote was not escaped.
+	std::list<std::string> opts;
+	std::stringstream      opt_stream{std::ios_base::in | std::ios_base::out | std::ios_base::binary};
+	std::stack<char>       quote_stack;
+	for (size_t p = 0; p <= text.size(); p++) {
+		char here = p < text.size() ? text.at(p) : 0;
+
+		if (here == '\\') {
+			size_t p2 = p + 1;
+			if (p2 < text.size()) {
+				char here2 = text.at(p2);
+				if (isdigit(here2)) { // Octal
+					// Not supported yet.
+					p++;
+				} else if (here2 == 'x') { // Hexadecimal
+					// Not supported yet.
+					p += 3;
+				} else if (here2 == 'u') { // 4 or 8 wide Unicode.
+					                   // Not supported yet.
+				} else if (here2 == 'a') {
+					opt_stream << '\a';
+					p++;
+				} else if (here2 == 'b') {
+					opt_stream << '\b';
+					p++;
+				} else if (here2 == 'f') {
+					opt_stream << '\f';
+					p++;
+				} else if (here2 == 'n') {
+					opt_stream << '\n';
+					p++;
+				} else if (here2 == 'r') {
+					opt_stream << '\r';
+					p++;
+				} else if (here2 == 't') {
+					opt_stream << '\t';
+					p++;
+				} else if (here2 == 'v') {
+					opt_stream << '\v';
+					p++;
+				} else if (here2 == '\\') {
+					opt_stream << '\\';
+					p++;
+				} else if (here2 == '\'') {
+					opt_stream << '\'';
+					p++;
+				} else if (here2 == '"') {
+					opt_stream << '"';
+					p++;
+				} else if (here2 == '?') {
+					opt_stream << '\?';
+					p++;
+				}
+			}
+		} else if ((here == '\'') || (here == '"')) {
+			if (quote_stack.size() > 1) {
+				opt_stream << here;
+			}
+			if (quote_stack.size() == 0) {
+				quote_stack.push(here);
+			} else if (quote_stack.top() == here) {
+				quote_stack.pop();
+			} else {
+				quote_stack.push(here);
+			}
+		} else if ((here == 0) || ((here == ' ') && (quote_stack.size() == 0))) {
+			std::string ropt = opt_stream.str();
+			if (ropt.size() > 0) {
+				opts.push_back(ropt);
+				opt_stream.str(std::string());
+				opt_stream.clear();
+			}
+		} else {
+			opt_stream << here;
+		}
+	}
+
+	// Now that we have a list of parameters as neatly grouped strings, and
+	//  have also dealt with escaping for the most part. We want to parse
+	//  an FFmpeg commandline option set here, so the first character in
+	//  the string must be a '-'.
+	for (std::string& opt : opts) {
+		// Skip empty options.
+		if (opt.size() == 0)
+			continue;
+
+		// Skip options that don't start with a '-'.
+		if (opt.at(0) != '-') {
+			PLOG_WARNING("Option '%s' is malformed, must start with a '-'.", opt.c_str());
+			continue;
+		}
+
+		// Skip options that don't contain a '='.
+		const char* cstr  = opt.c_str();
+		const char* eq_at = strchr(cstr, '=');
+		if (eq_at == nullptr) {
+			PLOG_WARNING("Option '%s' is malformed, must contain a '='.", opt.c_str());
+			continue;
+		}
+
+		std::string key   = opt.substr(1, eq_at - cstr - 1);
+		std::string value = opt.substr(eq_at - cstr + 1);
+
+		std::string error;
+		if (!index.validate(key, value, error)) {
+			PLOG_WARNING("Option '%s' (key: '%s', value: '%s') rejected: %s", opt.c_str(), key.c_str(),
+			             value.c_str(), error.c_str());
+			continue;
+		}
+
+		options.emplace_back(key, value);
+		av_dict_set(&dictionary, key.c_str(), value.c_str(), 0);
+	}
+}
+
+ffmpeg::option_set::~option_set()
+{
+	av_dict_free(&dictionary);
+}
+
+const std::string& ffmpeg::option_set::get_text() const
+{
+	return text;
+}
+
+const std::list<std::pair<std::string, std::string>>& ffmpeg::option_set::get_options() const
+{
+	return options;
+}
+
+AVDictionary* ffmpeg::option_set::create_dictionary() const
+{
+	AVDictionary* copy = nullptr;
+	av_dict_copy(&copy, dictionary, 0);
+	return copy;
+}
+
+uint64_t ffmpeg::option_set::hash(const std::string& text)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : text) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
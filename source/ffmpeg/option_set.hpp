@@ -0,0 +1,56 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cinttypes>
+#include <list>
+#include <string>
+#include <utility>
+#include "option_index.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/dict.h>
+#pragma warning(pop)
+}
+
+namespace ffmpeg {
+	// A set of options in FFmpeg command line syntax (-key=value -key2="value 2"), parsed and validated once.
+	class option_set {
+		std::string                                      text;
+		std::list<std::pair<std::string, std::string>> options;
+		AVDictionary*                                    dictionary = nullptr;
+
+		public:
+		option_set(std::string text, const option_index& index);
+		~option_set();
+
+		const std::string& get_text() const;
+
+		const std::list<std::pair<std::string, std::string>>& get_options() const;
+
+		// Copy of the options for avcodec_open2, must be freed with av_dict_free.
+		AVDictionary* create_dictionary() const;
+
+		static uint64_t hash(const std::string& text);
+	};
+} // namespace ffmpeg
@@ -0,0 +1,149 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "swresample.hpp"
+#include <stdexcept>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/channel_layout.h>
+#pragma warning(pop)
+}
+
+ffmpeg::swresample::swresample() {}
+
+ffmpeg::swresample::~swresample()
+{
+	finalize();
+}
+
+void ffmpeg::swresample::set_source(uint64_t layout, AVSampleFormat format, int32_t rate)
+{
+	source_layout = layout;
+	source_format = format;
+	source_rate   = rate;
+}
+
+uint64_t ffmpeg::swresample::get_source_layout()
+{
+	return this->source_layout;
+}
+
+AVSampleFormat ffmpeg::swresample::get_source_format()
+{
+	return this->source_format;
+}
+
+int32_t ffmpeg::swresample::get_source_rate()
+{
+	return this->source_rate;
+}
+
+void ffmpeg::swresample::set_target(uint64_t layout, AVSampleFormat format, int32_t rate)
+{
+	target_layout = layout;
+	target_format = format;
+	target_rate   = rate;
+}
+
+uint64_t ffmpeg::swresample::get_target_layout()
+{
+	return this->target_layout;
+}
+
+AVSampleFormat ffmpeg::swresample::get_target_format()
+{
+	return this->target_format;
+}
+
+int32_t ffmpeg::swresample::get_target_rate()
+{
+	return this->target_rate;
+}
+
+bool ffmpeg::swresample::is_passthrough()
+{
+	return (source_layout == target_layout) && (source_format == target_format) && (source_rate == target_rate);
+}
+
+bool ffmpeg::swresample::initialize()
+{
+	if (source_layout == 0 || source_format == AV_SAMPLE_FMT_NONE || source_rate == 0) {
+		throw std::invalid_argument("not all source parameters were set");
+	}
+	if (target_layout == 0 || target_format == AV_SAMPLE_FMT_NONE || target_rate == 0) {
+		throw std::invalid_argument("not all target parameters were set");
+	}
+
+	// Nothing to convert, so don't keep a context around either.
+	if (is_passthrough()) {
+		finalize();
+		return true;
+	}
+
+	if (this->context && (context_source_layout == source_layout) && (context_source_format == source_format)
+	    && (context_source_rate == source_rate) && (context_target_layout == target_layout)
+	    && (context_target_format == target_format) && (context_target_rate == target_rate)) {
+		return true;
+	}
+
+	// Re-uses the existing context if there is one.
+	this->context = swr_alloc_set_opts(this->context, static_cast<int64_t>(target_layout), target_format,
+	                                   target_rate, static_cast<int64_t>(source_layout), source_format,
+	                                   source_rate, 0, nullptr);
+	if (!this->context) {
+		return false;
+	}
+
+	if (swr_init(this->context) < 0) {
+		finalize();
+		return false;
+	}
+
+	context_source_layout = source_layout;
+	context_source_format = source_format;
+	context_source_rate   = source_rate;
+	context_target_layout = target_layout;
+	context_target_format = target_format;
+	context_target_rate   = target_rate;
+
+	return true;
+}
+
+bool ffmpeg::swresample::finalize()
+{
+	if (this->context) {
+		swr_free(&this->context);
+		return true;
+	}
+	return false;
+}
+
+int32_t ffmpeg::swresample::convert(const uint8_t* const source_data[], int32_t source_samples,
+                                    uint8_t* const target_data[], int32_t target_samples)
+{
+	if (!this->context) {
+		return 0;
+	}
+	return swr_convert(this->context, const_cast<uint8_t**>(target_data), target_samples,
+	                   const_cast<const uint8_t**>(source_data), source_samples);
+}
@@ -0,0 +1,81 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef OBS_FFMPEG_FFMPEG_SWRESAMPLE
+#define OBS_FFMPEG_FFMPEG_SWRESAMPLE
+#pragma once
+
+#include <cinttypes>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+#pragma warning(pop)
+}
+
+namespace ffmpeg {
+	class swresample {
+		uint64_t       source_layout = 0;
+		AVSampleFormat source_format = AV_SAMPLE_FMT_NONE;
+		int32_t        source_rate   = 0;
+
+		uint64_t       target_layout = 0;
+		AVSampleFormat target_format = AV_SAMPLE_FMT_NONE;
+		int32_t        target_rate   = 0;
+
+		// Parameters the context was last initialized with, to skip initialization if nothing changed.
+		uint64_t       context_source_layout = 0;
+		AVSampleFormat context_source_format = AV_SAMPLE_FMT_NONE;
+		int32_t        context_source_rate   = 0;
+		uint64_t       context_target_layout = 0;
+		AVSampleFormat context_target_format = AV_SAMPLE_FMT_NONE;
+		int32_t        context_target_rate   = 0;
+
+		SwrContext* context = nullptr;
+
+		public:
+		swresample();
+		~swresample();
+
+		void           set_source(uint64_t layout, AVSampleFormat format, int32_t rate);
+		uint64_t       get_source_layout();
+		AVSampleFormat get_source_format();
+		int32_t        get_source_rate();
+
+		void           set_target(uint64_t layout, AVSampleFormat format, int32_t rate);
+		uint64_t       get_target_layout();
+		AVSampleFormat get_target_format();
+		int32_t        get_target_rate();
+
+		// Source and target are identical, samples can be used as they are.
+		bool is_passthrough();
+
+		bool initialize();
+		bool finalize();
+
+		int32_t convert(const uint8_t* const source_data[], int32_t source_samples,
+		                uint8_t* const target_data[], int32_t target_samples);
+	};
+} // namespace ffmpeg
+
+#endif OBS_FFMPEG_FFMPEG_SWRESAMPLE
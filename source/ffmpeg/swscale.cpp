@@ -175,6 +175,7 @@ bool ffmpeg::swscale::initialize(int flags)
 		return false;
 	}
 
+	this->flags = flags;
 	sws_setColorspaceDetails(this->context, sws_getCoefficients(source_colorspace), source_full_range ? 1 : 0,
 	                         sws_getCoefficients(target_colorspace), target_full_range ? 1 : 0, 1L << 16 | 0L,
 	                         1L << 16 | 0L, 1L << 16 | 0L);
@@ -192,6 +193,25 @@ bool ffmpeg::swscale::finalize()
 	return false;
 }
 
+int ffmpeg::swscale::get_flags()
+{
+	return this->flags;
+}
+
+SwsContext* ffmpeg::swscale::release()
+{
+	SwsContext* context = this->context;
+	this->context       = nullptr;
+	return context;
+}
+
+void ffmpeg::swscale::adopt(SwsContext* context, int flags)
+{
+	finalize();
+	this->context = context;
+	this->flags   = flags;
+}
+
 int32_t ffmpeg::swscale::convert(const uint8_t* const source_data[], const int source_stride[], int32_t source_row,
                                  int32_t source_rows, uint8_t* const target_data[], const int target_stride[])
 {
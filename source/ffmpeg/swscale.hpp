@@ -47,6 +47,7 @@ namespace ffmpeg {
 		AVColorSpace                  target_colorspace = AVCOL_SPC_UNSPECIFIED;
 
 		SwsContext* context = nullptr;
+		int         flags   = 0;
 
 		public:
 		swscale();
@@ -80,6 +81,11 @@ namespace ffmpeg {
 
 		bool initialize(int flags);
 		bool finalize();
+		int  get_flags();
+
+		// Hand the context over to someone else, or take over one that was created with the same parameters.
+		SwsContext* release();
+		void        adopt(SwsContext* context, int flags);
 
 		int32_t convert(const uint8_t* const source_data[], const int source_stride[], int32_t source_row,
 		                int32_t source_rows, uint8_t* const target_data[], const int target_stride[]);
@@ -31,6 +31,7 @@ extern "C" {
 #pragma warning(push)
 #pragma warning(disable : 4244)
 #include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
 #include <libavutil/error.h>
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
@@ -166,6 +167,56 @@ AVPixelFormat ffmpeg::tools::get_least_lossy_format(const AVPixelFormat* haystac
 	return avcodec_find_best_pix_fmt_of_list(haystack, needle, 0, &data_loss);
 }
 
+static std::map<audio_format, AVSampleFormat> obs_to_av_sample_format_map = {
+    {AUDIO_FORMAT_U8BIT, AV_SAMPLE_FMT_U8},          //
+    {AUDIO_FORMAT_16BIT, AV_SAMPLE_FMT_S16},         //
+    {AUDIO_FORMAT_32BIT, AV_SAMPLE_FMT_S32},         //
+    {AUDIO_FORMAT_FLOAT, AV_SAMPLE_FMT_FLT},         //
+    {AUDIO_FORMAT_U8BIT_PLANAR, AV_SAMPLE_FMT_U8P},  //
+    {AUDIO_FORMAT_16BIT_PLANAR, AV_SAMPLE_FMT_S16P}, //
+    {AUDIO_FORMAT_32BIT_PLANAR, AV_SAMPLE_FMT_S32P}, //
+    {AUDIO_FORMAT_FLOAT_PLANAR, AV_SAMPLE_FMT_FLTP}, //
+};
+
+AVSampleFormat ffmpeg::tools::obs_audioformat_to_avsampleformat(audio_format v)
+{
+	auto found = obs_to_av_sample_format_map.find(v);
+	if (found != obs_to_av_sample_format_map.end()) {
+		return found->second;
+	}
+	return AV_SAMPLE_FMT_NONE;
+}
+
+audio_format ffmpeg::tools::avsampleformat_to_obs_audioformat(AVSampleFormat v)
+{
+	for (const auto& kv : obs_to_av_sample_format_map) {
+		if (kv.second == v)
+			return kv.first;
+	}
+	return AUDIO_FORMAT_UNKNOWN;
+}
+
+uint64_t ffmpeg::tools::obs_speakerlayout_to_avchannellayout(speaker_layout v)
+{
+	switch (v) {
+	case SPEAKERS_MONO:
+		return AV_CH_LAYOUT_MONO;
+	case SPEAKERS_STEREO:
+		return AV_CH_LAYOUT_STEREO;
+	case SPEAKERS_2POINT1:
+		return AV_CH_LAYOUT_2POINT1;
+	case SPEAKERS_4POINT0:
+		return AV_CH_LAYOUT_4POINT0;
+	case SPEAKERS_4POINT1:
+		return AV_CH_LAYOUT_4POINT1;
+	case SPEAKERS_5POINT1:
+		return AV_CH_LAYOUT_5POINT1_BACK;
+	case SPEAKERS_7POINT1:
+		return AV_CH_LAYOUT_7POINT1;
+	}
+	throw std::invalid_argument("unknown speaker layout");
+}
+
 AVColorSpace ffmpeg::tools::obs_videocolorspace_to_avcolorspace(video_colorspace v)
 {
 	switch (v) {
@@ -204,6 +255,24 @@ bool ffmpeg::tools::can_hardware_encode(const AVCodec* codec)
 	return false;
 }
 
+bool ffmpeg::tools::is_intra_only(const AVCodec* codec)
+{
+	if (codec->capabilities & AV_CODEC_CAP_INTRA_ONLY)
+		return true;
+
+	const AVCodecDescriptor* desc = avcodec_descriptor_get(codec->id);
+	return desc && (desc->props & AV_CODEC_PROP_INTRA_ONLY);
+}
+
+bool ffmpeg::tools::has_private_option(const AVCodec* codec, const char* name)
+{
+	if (!codec->priv_class)
+		return false;
+
+	const AVClass* cls = codec->priv_class;
+	return av_opt_find(&cls, name, nullptr, 0, AV_OPT_SEARCH_FAKE_OBJ) != nullptr;
+}
+
 std::vector<AVPixelFormat> ffmpeg::tools::get_software_formats(const AVPixelFormat* list)
 {
 	AVPixelFormat hardware_formats[] = {
@@ -351,3 +420,12 @@ void ffmpeg::tools::print_av_option_string(AVCodecContext* context, const char*
 		PLOG_INFO("[%s] %s: <Default>", context->codec->name, text.c_str());
 	}
 }
+
+void ffmpeg::tools::print_av_option_string(AVCodecContext* context, const char* option, std::string text,
+                                           const option_index& index)
+{
+	print_av_option_string(context, option, text, [&index, option](int64_t v) {
+		const char* name = index.find_constant_name(option, v);
+		return std::string(name ? name : "<Unknown>");
+	});
+}
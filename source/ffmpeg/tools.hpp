@@ -27,10 +27,12 @@
 #include <obs.h>
 #include <string>
 #include <vector>
+#include "option_index.hpp"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/pixfmt.h>
+#include <libavutil/samplefmt.h>
 }
 
 namespace ffmpeg {
@@ -49,12 +51,24 @@ namespace ffmpeg {
 
 		AVPixelFormat get_least_lossy_format(const AVPixelFormat* haystack, AVPixelFormat needle);
 
+		AVSampleFormat obs_audioformat_to_avsampleformat(audio_format v);
+
+		audio_format avsampleformat_to_obs_audioformat(AVSampleFormat v);
+
+		uint64_t obs_speakerlayout_to_avchannellayout(speaker_layout v);
+
 		AVColorSpace obs_videocolorspace_to_avcolorspace(video_colorspace v);
 
 		AVColorRange obs_videorangetype_to_avcolorrange(video_range_type v);
 
 		bool can_hardware_encode(const AVCodec* codec);
 
+		// Every frame is a keyframe, so frames can be encoded independently of each other.
+		bool is_intra_only(const AVCodec* codec);
+
+		// Private option of the encoder, like 'intra-refresh' or 'forced-idr'.
+		bool has_private_option(const AVCodec* codec, const char* name);
+
 		std::vector<AVPixelFormat> get_software_formats(const AVPixelFormat* list);
 
 		void setup_obs_color(video_colorspace colorspace, video_range_type range, AVCodecContext* context);
@@ -71,6 +85,10 @@ namespace ffmpeg {
 		void print_av_option_string(AVCodecContext* context, const char* option, std::string text,
 		                                   std::function<std::string(int64_t)> decoder);
 
+		// Decodes the value through the constants of the option.
+		void print_av_option_string(AVCodecContext* context, const char* option, std::string text,
+		                            const option_index& index);
+
 	} // namespace tools
 } // namespace ffmpeg
 
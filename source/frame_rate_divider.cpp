@@ -0,0 +1,89 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "frame_rate_divider.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+#pragma warning(pop)
+}
+
+obsffmpeg::frame_rate_divider::frame_rate_divider()
+    : _source({0, 1}), _target({0, 1}), _active(false), _started(false), _last(0)
+{}
+
+void obsffmpeg::frame_rate_divider::setup(AVRational source, AVRational target)
+{
+	_active = (source.num > 0) && (source.den > 0) && (target.num > 0) && (target.den > 0)
+	          && (av_cmp_q(target, source) < 0);
+	if (!_active) {
+		_source = _target = source;
+		return;
+	}
+
+	// A reopened context continues where the previous one stopped, unless the rates changed.
+	if ((av_cmp_q(source, _source) != 0) || (av_cmp_q(target, _target) != 0))
+		_started = false;
+	_source = source;
+	_target = target;
+}
+
+bool obsffmpeg::frame_rate_divider::is_active()
+{
+	return _active;
+}
+
+AVRational obsffmpeg::frame_rate_divider::get_target()
+{
+	return _target;
+}
+
+bool obsffmpeg::frame_rate_divider::select(int64_t pts, int64_t& target_pts)
+{
+	if (!_active) {
+		target_pts = pts;
+		return true;
+	}
+
+	// The first source frame within each target frame interval is encoded, all others are skipped.
+	int64_t index = av_rescale_rnd(pts, int64_t(_target.num) * _source.den, int64_t(_target.den) * _source.num,
+	                               AV_ROUND_DOWN);
+	if (_started && (index <= _last))
+		return false;
+
+	_started   = true;
+	_last      = index;
+	target_pts = index;
+	return true;
+}
+
+int64_t obsffmpeg::frame_rate_divider::to_source(int64_t ts)
+{
+	if (!_active || (ts == AV_NOPTS_VALUE))
+		return ts;
+
+	// Rounding up lands on the source frame that select picked for this target frame.
+	return av_rescale_rnd(ts, int64_t(_source.num) * _target.den, int64_t(_source.den) * _target.num,
+	                      AV_ROUND_UP);
+}
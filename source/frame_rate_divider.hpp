@@ -0,0 +1,58 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cinttypes>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/rational.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	// Picks the frames for an encoder that runs at a lower frame rate than OBS Studio. Timestamps of OBS Studio
+	// count frames at the source rate, the encoder gets timestamps that count frames at the target rate.
+	class frame_rate_divider {
+		AVRational _source;
+		AVRational _target;
+		bool       _active;
+		bool       _started;
+		int64_t    _last;
+
+		public:
+		frame_rate_divider();
+
+		// Target rates that are not below the source rate turn the divider off.
+		void setup(AVRational source, AVRational target);
+
+		bool is_active();
+
+		AVRational get_target();
+
+		// Returns false if the frame is skipped, otherwise sets the timestamp for the encoder.
+		bool select(int64_t pts, int64_t& target_pts);
+
+		// Converts a timestamp of the encoder back to the source rate.
+		int64_t to_source(int64_t ts);
+	};
+} // namespace obsffmpeg
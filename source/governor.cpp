@@ -0,0 +1,134 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "governor.hpp"
+#include <algorithm>
+
+// Presets of libx264 and libx265, from fastest to slowest.
+static const std::vector<std::string> x264_presets = {
+    "ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow", "placebo",
+};
+
+// Preset steps to try before touching resolution or frame rate.
+#define PRESET_STEPS 2
+
+// Fraction of the frame interval above which a frame counts as over budget, and below which it counts as headroom.
+#define BUDGET_OVER 0.9
+#define BUDGET_UNDER 0.5
+
+// Seconds of sustained overload before stepping down, of headroom before stepping up, and to wait after a change.
+#define SECONDS_OVER 1
+#define SECONDS_UNDER 10
+#define SECONDS_HOLD 2
+
+static uint32_t make_even(uint32_t v)
+{
+	return std::max<uint32_t>(v & ~1u, 2);
+}
+
+obsffmpeg::governor::governor(mode max_mode, const std::string& preset, uint32_t width, uint32_t height,
+                              double_t interval)
+    : _level(0), _interval(interval)
+{
+	_levels.push_back({"", width, height, 1});
+
+	if (max_mode >= mode::PRESET) {
+		auto found = std::find(x264_presets.begin(), x264_presets.end(), preset);
+		if (found != x264_presets.end()) {
+			for (size_t step = 0; (step < PRESET_STEPS) && (found != x264_presets.begin()); step++) {
+				found--;
+				_levels.push_back({*found, width, height, 1});
+			}
+		}
+	}
+
+	if (max_mode >= mode::RESOLUTION) {
+		governor_level last = _levels.back();
+		_levels.push_back({last.preset, make_even(width * 3 / 4), make_even(height * 3 / 4), 1});
+		_levels.push_back({last.preset, make_even(width / 2), make_even(height / 2), 1});
+	}
+
+	if (max_mode >= mode::FRAMERATE) {
+		governor_level last = _levels.back();
+		last.fps_divider    = 2;
+		_levels.push_back(last);
+	}
+
+	reset();
+}
+
+void obsffmpeg::governor::reset()
+{
+	_average = 0;
+	_over    = 0;
+	_under   = 0;
+	_hold    = static_cast<size_t>(SECONDS_HOLD / (_interval * _levels[_level].fps_divider));
+}
+
+bool obsffmpeg::governor::record(std::chrono::nanoseconds duration)
+{
+	double_t seconds = std::chrono::duration<double_t>(duration).count();
+	_average         = (_average > 0) ? (_average * 0.9 + seconds * 0.1) : seconds;
+
+	if (_hold > 0) {
+		_hold--;
+		return false;
+	}
+
+	double_t budget     = _interval * _levels[_level].fps_divider;
+	size_t   per_second = std::max<size_t>(static_cast<size_t>(1.0 / budget), 1);
+	if (_average > (budget * BUDGET_OVER)) {
+		_over++;
+		_under = 0;
+	} else if (_average < (budget * BUDGET_UNDER)) {
+		_under++;
+		_over = 0;
+	} else {
+		_over  = 0;
+		_under = 0;
+	}
+
+	if ((_over >= (per_second * SECONDS_OVER)) && ((_level + 1) < _levels.size())) {
+		_level++;
+		reset();
+		return true;
+	} else if ((_under >= (per_second * SECONDS_UNDER)) && (_level > 0)) {
+		_level--;
+		reset();
+		return true;
+	}
+	return false;
+}
+
+const obsffmpeg::governor_level& obsffmpeg::governor::get_level()
+{
+	return _levels[_level];
+}
+
+size_t obsffmpeg::governor::get_level_index()
+{
+	return _level;
+}
+
+size_t obsffmpeg::governor::get_level_count()
+{
+	return _levels.size();
+}
@@ -0,0 +1,70 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+namespace obsffmpeg {
+	struct governor_level {
+		std::string preset; // Empty keeps the configured preset.
+		uint32_t    width;
+		uint32_t    height;
+		uint32_t    fps_divider;
+	};
+
+	// Watches the time spent encoding each frame against the frame interval, and moves through a ladder of
+	// cheaper configurations while the encoder can't keep up. Steps back up once there is headroom again.
+	class governor {
+		public:
+		enum class mode : int64_t {
+			DISABLED,
+			PRESET,
+			RESOLUTION,
+			FRAMERATE,
+		};
+
+		private:
+		std::vector<governor_level> _levels;
+		size_t                      _level;
+		double_t                    _interval;
+		double_t                    _average;
+		size_t                      _over;
+		size_t                      _under;
+		size_t                      _hold;
+
+		void reset();
+
+		public:
+		governor(mode max_mode, const std::string& preset, uint32_t width, uint32_t height, double_t interval);
+
+		// Returns true if the level changed.
+		bool record(std::chrono::nanoseconds duration);
+
+		const governor_level& get_level();
+
+		size_t get_level_index();
+
+		size_t get_level_count();
+	};
+} // namespace obsffmpeg
@@ -0,0 +1,296 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Encoder host, runs a single AVCodecContext on behalf of the plugin so that a crashing or stalling encoder can't
+// take OBS Studio down with it. Frames arrive through the ring on descriptor 3, packets leave through descriptor 4.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include "ipc/protocol.hpp"
+#include "ipc/shm_ring.hpp"
+#include "thread_policy.hpp"
+
+extern "C" {
+#include <signal.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#pragma warning(pop)
+}
+
+using namespace obsffmpeg::ipc;
+
+static const std::chrono::milliseconds POLL_INTERVAL = std::chrono::milliseconds(100);
+
+static bool send_message(shm_ring& ring, message_header header, const void* data, size_t size)
+{
+	iovec parts[2] = {{&header, sizeof(header)}, {const_cast<void*>(data), size}};
+	// The plugin keeps draining packets for as long as it is interested in them.
+	while (!ring.write(parts, 2, POLL_INTERVAL)) {
+		if (ring.is_closed())
+			return false;
+	}
+	return true;
+}
+
+static void send_failure(shm_ring& ring, const std::string& reason)
+{
+	message_header header = {message_type::FAILED, 0, 0, 0, 0, 0};
+	fprintf(stderr, "encoder host: %s\n", reason.c_str());
+	send_message(ring, header, reason.data(), reason.size());
+}
+
+static std::string get_error(int res)
+{
+	char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+	av_strerror(res, buffer, sizeof(buffer));
+	return buffer;
+}
+
+static AVCodecContext* configure(const std::vector<uint8_t>& buffer, AVDictionary** options, std::string& error)
+{
+	std::map<std::string, std::string> values;
+	{
+		const char*       text = reinterpret_cast<const char*>(buffer.data()) + sizeof(message_header);
+		std::stringstream stream(std::string(text, buffer.size() - sizeof(message_header)));
+		std::string       line;
+		while (std::getline(stream, line)) {
+			size_t split = line.find('=');
+			if (split != std::string::npos)
+				values.emplace(line.substr(0, split), line.substr(split + 1));
+		}
+	}
+
+	const AVCodec* codec = avcodec_find_encoder_by_name(values["codec"].c_str());
+	if (!codec) {
+		error = "Unknown encoder '" + values["codec"] + "'.";
+		return nullptr;
+	}
+
+	AVCodecContext* context = avcodec_alloc_context3(codec);
+	if (!context) {
+		error = "Failed to allocate context.";
+		return nullptr;
+	}
+
+	int res = av_set_options_string(context, values["context"].c_str(), "=", ":");
+	if ((res >= 0) && context->priv_data)
+		res = av_set_options_string(context->priv_data, values["private"].c_str(), "=", ":");
+	if (res < 0) {
+		error = "Failed to apply options: " + get_error(res);
+		avcodec_free_context(&context);
+		return nullptr;
+	}
+
+	context->width                   = std::stoi(values["width"]);
+	context->height                  = std::stoi(values["height"]);
+	context->pix_fmt                 = av_get_pix_fmt(values["pix_fmt"].c_str());
+	context->color_range             = static_cast<AVColorRange>(std::stoi(values["color_range"]));
+	context->colorspace              = static_cast<AVColorSpace>(std::stoi(values["colorspace"]));
+	context->color_primaries         = static_cast<AVColorPrimaries>(std::stoi(values["color_primaries"]));
+	context->color_trc               = static_cast<AVColorTransferCharacteristic>(std::stoi(values["color_trc"]));
+	context->chroma_sample_location  = static_cast<AVChromaLocation>(std::stoi(values["chroma_location"]));
+	context->ticks_per_frame         = std::stoi(values["ticks_per_frame"]);
+	sscanf(values["time_base"].c_str(), "%d/%d", &context->time_base.num, &context->time_base.den);
+	sscanf(values["framerate"].c_str(), "%d/%d", &context->framerate.num, &context->framerate.den);
+	sscanf(values["sar"].c_str(), "%d/%d", &context->sample_aspect_ratio.num, &context->sample_aspect_ratio.den);
+
+	av_dict_parse_string(options, values["options"].c_str(), "=", ":", 0);
+	return context;
+}
+
+static bool load_frame(AVCodecContext* context, const std::vector<uint8_t>& buffer, AVFrame* frame)
+{
+	const message_header* header = reinterpret_cast<const message_header*>(buffer.data());
+	const uint8_t*        ptr    = buffer.data() + sizeof(message_header);
+	const uint8_t*        end    = buffer.data() + buffer.size();
+
+	av_frame_unref(frame);
+	frame->width           = context->width;
+	frame->height          = context->height;
+	frame->format          = context->pix_fmt;
+	frame->color_range     = context->color_range;
+	frame->colorspace      = context->colorspace;
+	frame->color_primaries = context->color_primaries;
+	frame->color_trc       = context->color_trc;
+	if (av_frame_get_buffer(frame, 32) < 0)
+		return false;
+
+	frame->pts       = header->pts;
+	frame->pict_type = (header->flags & FRAME_FLAG_KEY) ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+
+	for (uint32_t plane = 0; plane < header->planes; plane++) {
+		plane_header info;
+		if ((plane >= AV_NUM_DATA_POINTERS) || (end - ptr < static_cast<ptrdiff_t>(sizeof(info))))
+			return false;
+		memcpy(&info, ptr, sizeof(info));
+		ptr += sizeof(info);
+
+		size_t size = static_cast<size_t>(info.linesize) * static_cast<size_t>(info.height);
+		if (!frame->data[plane] || (static_cast<size_t>(end - ptr) < size))
+			return false;
+		av_image_copy_plane(frame->data[plane], frame->linesize[plane], ptr, info.linesize,
+		                    FFMIN(info.linesize, frame->linesize[plane]), info.height);
+		ptr += size;
+	}
+	return true;
+}
+
+static bool drain(AVCodecContext* context, AVPacket* packet, shm_ring& packets)
+{
+	int res;
+	while ((res = avcodec_receive_packet(context, packet)) == 0) {
+		message_header header = {message_type::PACKET, packet->flags, packet->pts, packet->dts, 0, 0};
+		bool           sent   = send_message(packets, header, packet->data, static_cast<size_t>(packet->size));
+		av_packet_unref(packet);
+		if (!sent)
+			return false;
+	}
+	if ((res != AVERROR(EAGAIN)) && (res != AVERROR_EOF)) {
+		send_failure(packets, "Failed to receive packet: " + get_error(res));
+		return false;
+	}
+	return true;
+}
+
+static int run(shm_ring& frames, shm_ring& packets)
+{
+	std::vector<uint8_t> buffer;
+
+	// The first message always configures the context.
+	while (!frames.read(buffer, POLL_INTERVAL)) {
+		if (frames.is_closed())
+			return 1;
+	}
+	if ((buffer.size() < sizeof(message_header))
+	    || (reinterpret_cast<const message_header*>(buffer.data())->type != message_type::CONFIGURE)) {
+		send_failure(packets, "Expected configuration.");
+		return 1;
+	}
+
+	std::string     error;
+	AVDictionary*   options = nullptr;
+	AVCodecContext* context = configure(buffer, &options, error);
+	if (!context) {
+		send_failure(packets, error);
+		return 1;
+	}
+
+	int res = avcodec_open2(context, context->codec, &options);
+	av_dict_free(&options);
+	if (res < 0) {
+		send_failure(packets, "Failed to open encoder: " + get_error(res));
+		avcodec_free_context(&context);
+		return 1;
+	}
+
+	message_header opened = {message_type::OPENED, 0, 0, 0, 0, 0};
+	send_message(packets, opened, context->extradata, static_cast<size_t>(context->extradata_size));
+
+	AVFrame*  frame  = av_frame_alloc();
+	AVPacket* packet = av_packet_alloc();
+	int       code   = 0;
+	while (true) {
+		if (!frames.read(buffer, POLL_INTERVAL)) {
+			if (frames.is_closed())
+				break;
+			continue;
+		}
+		if (buffer.size() < sizeof(message_header))
+			continue;
+
+		message_type type = reinterpret_cast<const message_header*>(buffer.data())->type;
+		if (type == message_type::FRAME) {
+			if (!load_frame(context, buffer, frame)) {
+				send_failure(packets, "Received a malformed frame.");
+				code = 1;
+				break;
+			}
+			res = avcodec_send_frame(context, frame);
+		} else if (type == message_type::FLUSH) {
+			res = avcodec_send_frame(context, nullptr);
+		} else {
+			continue;
+		}
+
+		if (res < 0) {
+			send_failure(packets, "Failed to send frame: " + get_error(res));
+			code = 1;
+			break;
+		}
+		if (!drain(context, packet, packets)) {
+			code = 1;
+			break;
+		}
+		if (type == message_type::FLUSH) {
+			message_header flushed = {message_type::FLUSHED, 0, 0, 0, 0, 0};
+			send_message(packets, flushed, nullptr, 0);
+			break;
+		}
+	}
+
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&context);
+	return code;
+}
+
+int main(int argc, char* argv[])
+{
+	// Never outlive the process that spawned us.
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+	if (getppid() == 1)
+		return 1;
+
+	obsffmpeg::thread_policy policy;
+	for (int idx = 1; idx < argc; idx++) {
+		if ((strcmp(argv[idx], "--nice") == 0) && (idx + 1 < argc)) {
+			policy.nice = atoi(argv[++idx]);
+		} else if ((strcmp(argv[idx], "--cpus") == 0) && (idx + 1 < argc)) {
+			policy.cpus = argv[++idx];
+		} else if (strcmp(argv[idx], "--batch") == 0) {
+			policy.batch = true;
+		}
+	}
+
+	// Applies to every thread the encoder starts later on.
+	if (!policy.apply())
+		fprintf(stderr, "encoder host: Failed to apply thread policy.\n");
+
+	try {
+		auto frames  = shm_ring::attach(3);
+		auto packets = shm_ring::attach(4);
+		return run(*frames, *packets);
+	} catch (const std::exception& ex) {
+		fprintf(stderr, "encoder host: %s\n", ex.what());
+		return 1;
+	}
+}
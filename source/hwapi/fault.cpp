@@ -0,0 +1,79 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "fault.hpp"
+#include <stdexcept>
+#include "utility.hpp"
+
+#define ST_CONFIG_FAULTAFTER "FaultInjection.After"
+#define ST_CONFIG_FAULTCOUNT "FaultInjection.Count"
+
+obsffmpeg::hwapi::fault_instance::fault_instance(std::shared_ptr<obsffmpeg::hwapi::instance> inner, uint64_t after,
+                                                 uint64_t count)
+    : _inner(inner), _after(after), _count(count), _calls(0)
+{}
+
+obsffmpeg::hwapi::fault_instance::~fault_instance() {}
+
+void obsffmpeg::hwapi::fault_instance::get_defaults(obs_data_t* config)
+{
+	obs_data_set_default_int(config, ST_CONFIG_FAULTAFTER, 0);
+	obs_data_set_default_int(config, ST_CONFIG_FAULTCOUNT, 0);
+}
+
+std::shared_ptr<obsffmpeg::hwapi::instance>
+    obsffmpeg::hwapi::fault_instance::wrap(std::shared_ptr<obsffmpeg::hwapi::instance> inner, obs_data_t* config)
+{
+	uint64_t count = config ? static_cast<uint64_t>(obs_data_get_int(config, ST_CONFIG_FAULTCOUNT)) : 0;
+	if (count == 0)
+		return inner;
+
+	uint64_t after = static_cast<uint64_t>(obs_data_get_int(config, ST_CONFIG_FAULTAFTER));
+	PLOG_WARNING("Injecting %llu texture copy faults after %llu frames.", count, after);
+	return std::make_shared<fault_instance>(inner, after, count);
+}
+
+AVBufferRef* obsffmpeg::hwapi::fault_instance::create_device_context()
+{
+	return _inner->create_device_context();
+}
+
+std::shared_ptr<AVFrame> obsffmpeg::hwapi::fault_instance::allocate_frame(AVBufferRef* frames)
+{
+	return _inner->allocate_frame(frames);
+}
+
+void obsffmpeg::hwapi::fault_instance::copy_from_obs(AVBufferRef* frames, uint32_t handle, uint64_t lock_key,
+                                                     uint64_t* next_lock_key, std::shared_ptr<AVFrame> frame)
+{
+	_calls++;
+	if ((_calls > _after) && (_calls <= (_after + _count)))
+		throw std::runtime_error("Injected texture copy fault.");
+	_inner->copy_from_obs(frames, handle, lock_key, next_lock_key, frame);
+}
+
+std::shared_ptr<AVFrame> obsffmpeg::hwapi::fault_instance::avframe_from_obs(AVBufferRef* frames, uint32_t handle,
+                                                                           uint64_t lock_key, uint64_t* next_lock_key)
+{
+	auto frame = allocate_frame(frames);
+	copy_from_obs(frames, handle, lock_key, next_lock_key, frame);
+	return frame;
+}
@@ -0,0 +1,63 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "base.hpp"
+
+extern "C" {
+#include <obs.h>
+}
+
+namespace obsffmpeg {
+	namespace hwapi {
+		// Stand-in around another instance that fails texture copies on purpose, to exercise the failover of
+		// texture encoders. Only built with ENABLE_FAULT_INJECTION.
+		class fault_instance : public ::obsffmpeg::hwapi::instance {
+			std::shared_ptr<obsffmpeg::hwapi::instance> _inner;
+			uint64_t                                    _after;
+			uint64_t                                    _count;
+			uint64_t                                    _calls;
+
+			public:
+			// Copies after the first 'after' ones fail, 'count' times in a row.
+			fault_instance(std::shared_ptr<obsffmpeg::hwapi::instance> inner, uint64_t after,
+			               uint64_t count);
+			virtual ~fault_instance();
+
+			static void get_defaults(obs_data_t* config);
+
+			// Wraps the instance if the configuration asks for faults, otherwise returns it unchanged.
+			static std::shared_ptr<obsffmpeg::hwapi::instance>
+			    wrap(std::shared_ptr<obsffmpeg::hwapi::instance> inner, obs_data_t* config);
+
+			virtual AVBufferRef* create_device_context() override;
+
+			virtual std::shared_ptr<AVFrame> allocate_frame(AVBufferRef* frames) override;
+
+			virtual void copy_from_obs(AVBufferRef* frames, uint32_t handle, uint64_t lock_key,
+			                           uint64_t* next_lock_key, std::shared_ptr<AVFrame> frame) override;
+
+			virtual std::shared_ptr<AVFrame> avframe_from_obs(AVBufferRef* frames, uint32_t handle,
+			                                                  uint64_t  lock_key,
+			                                                  uint64_t* next_lock_key) override;
+		};
+	} // namespace hwapi
+} // namespace obsffmpeg
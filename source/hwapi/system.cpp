@@ -0,0 +1,167 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "system.hpp"
+#include <stdexcept>
+#include "utility.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/frame.h>
+#pragma warning(pop)
+}
+
+static std::mutex                                                            surfaces_lock;
+static std::map<uint32_t, std::shared_ptr<obsffmpeg::hwapi::system_surface>> surfaces;
+static uint32_t                                                              surfaces_next = 1;
+
+obsffmpeg::hwapi::system_surface::system_surface(std::shared_ptr<AVFrame> frame, uint64_t key)
+    : _frame(frame), _key(key), _acquired(false)
+{}
+
+obsffmpeg::hwapi::system_surface::~system_surface() {}
+
+std::shared_ptr<AVFrame> obsffmpeg::hwapi::system_surface::get_frame()
+{
+	return _frame;
+}
+
+bool obsffmpeg::hwapi::system_surface::acquire(uint64_t key, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> ulock(_lock);
+	if (!_signal.wait_for(ulock, timeout, [this, key]() { return !_acquired && (_key == key); }))
+		return false;
+	_acquired = true;
+	return true;
+}
+
+void obsffmpeg::hwapi::system_surface::release(uint64_t key)
+{
+	{
+		std::unique_lock<std::mutex> ulock(_lock);
+		_acquired = false;
+		_key      = key;
+	}
+	_signal.notify_all();
+}
+
+obsffmpeg::hwapi::system::system() {}
+
+obsffmpeg::hwapi::system::~system() {}
+
+std::list<obsffmpeg::hwapi::device> obsffmpeg::hwapi::system::enumerate_adapters()
+{
+	device dev;
+	dev.name      = "System Memory";
+	dev.id.first  = 0;
+	dev.id.second = 0;
+	return {dev};
+}
+
+std::shared_ptr<obsffmpeg::hwapi::instance> obsffmpeg::hwapi::system::create(obsffmpeg::hwapi::device)
+{
+	return std::make_shared<system_instance>();
+}
+
+std::shared_ptr<obsffmpeg::hwapi::instance> obsffmpeg::hwapi::system::create_from_obs()
+{
+	return std::make_shared<system_instance>();
+}
+
+uint32_t obsffmpeg::hwapi::system::register_surface(std::shared_ptr<system_surface> surface)
+{
+	std::unique_lock<std::mutex> ulock(surfaces_lock);
+	uint32_t                     handle = surfaces_next++;
+	surfaces.emplace(handle, surface);
+	return handle;
+}
+
+void obsffmpeg::hwapi::system::unregister_surface(uint32_t handle)
+{
+	std::unique_lock<std::mutex> ulock(surfaces_lock);
+	surfaces.erase(handle);
+}
+
+std::shared_ptr<obsffmpeg::hwapi::system_surface> obsffmpeg::hwapi::system::find_surface(uint32_t handle)
+{
+	std::unique_lock<std::mutex> ulock(surfaces_lock);
+	auto                         found = surfaces.find(handle);
+	if (found == surfaces.end())
+		return nullptr;
+	return found->second;
+}
+
+obsffmpeg::hwapi::system_instance::system_instance() {}
+
+obsffmpeg::hwapi::system_instance::~system_instance() {}
+
+AVBufferRef* obsffmpeg::hwapi::system_instance::create_device_context()
+{
+	return nullptr;
+}
+
+std::shared_ptr<AVFrame> obsffmpeg::hwapi::system_instance::allocate_frame(AVBufferRef*)
+{
+	// The buffer is allocated on the first copy, when the size and format of the surface are known.
+	return std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
+		av_frame_unref(frame);
+		av_frame_free(&frame);
+	});
+}
+
+void obsffmpeg::hwapi::system_instance::copy_from_obs(AVBufferRef*, uint32_t handle, uint64_t lock_key,
+                                                      uint64_t* next_lock_key, std::shared_ptr<AVFrame> frame)
+{
+	auto surface = system::find_surface(handle);
+	if (!surface)
+		throw std::runtime_error("Failed to find surface for handle.");
+
+	if (!surface->acquire(lock_key, std::chrono::milliseconds(1000)))
+		throw std::runtime_error("Failed to acquire lock on input surface.");
+
+	std::shared_ptr<AVFrame> input = surface->get_frame();
+	if (!frame->buf[0] || (frame->width != input->width) || (frame->height != input->height)
+	    || (frame->format != input->format)) {
+		av_frame_unref(frame.get());
+		frame->width  = input->width;
+		frame->height = input->height;
+		frame->format = input->format;
+		if (av_frame_get_buffer(frame.get(), 32) < 0) {
+			surface->release(lock_key);
+			throw std::runtime_error("Failed to allocate frame buffer.");
+		}
+	}
+
+	int res = av_frame_copy(frame.get(), input.get());
+	surface->release(*next_lock_key);
+	if (res < 0)
+		throw std::runtime_error("Failed to copy input surface.");
+}
+
+std::shared_ptr<AVFrame> obsffmpeg::hwapi::system_instance::avframe_from_obs(AVBufferRef* frames, uint32_t handle,
+                                                                             uint64_t  lock_key,
+                                                                             uint64_t* next_lock_key)
+{
+	auto frame = this->allocate_frame(frames);
+	this->copy_from_obs(frames, handle, lock_key, next_lock_key, frame);
+	return frame;
+}
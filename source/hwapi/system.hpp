@@ -0,0 +1,90 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include "base.hpp"
+
+namespace obsffmpeg {
+	namespace hwapi {
+		// A frame in system memory that stands in for a shared texture, including an emulated keyed mutex.
+		class system_surface {
+			std::shared_ptr<AVFrame> _frame;
+			std::mutex               _lock;
+			std::condition_variable  _signal;
+			uint64_t                 _key;
+			bool                     _acquired;
+
+			public:
+			system_surface(std::shared_ptr<AVFrame> frame, uint64_t key = 0);
+			~system_surface();
+
+			std::shared_ptr<AVFrame> get_frame();
+
+			// Wait until the surface was released with the given key, like IDXGIKeyedMutex::AcquireSync.
+			bool acquire(uint64_t key, std::chrono::milliseconds timeout);
+
+			void release(uint64_t key);
+		};
+
+		// Backend without a GPU, textures are plain AVFrames in system memory identified by a handle.
+		class system : public ::obsffmpeg::hwapi::base {
+			public:
+			system();
+			virtual ~system();
+
+			virtual std::list<obsffmpeg::hwapi::device> enumerate_adapters() override;
+
+			virtual std::shared_ptr<obsffmpeg::hwapi::instance>
+			    create(obsffmpeg::hwapi::device target) override;
+
+			virtual std::shared_ptr<obsffmpeg::hwapi::instance> create_from_obs() override;
+
+			public:
+			static uint32_t register_surface(std::shared_ptr<system_surface> surface);
+
+			static void unregister_surface(uint32_t handle);
+
+			static std::shared_ptr<system_surface> find_surface(uint32_t handle);
+		};
+
+		class system_instance : public ::obsffmpeg::hwapi::instance {
+			public:
+			system_instance();
+			virtual ~system_instance();
+
+			// There is no device, the encoder is fed software frames.
+			virtual AVBufferRef* create_device_context() override;
+
+			virtual std::shared_ptr<AVFrame> allocate_frame(AVBufferRef* frames) override;
+
+			virtual void copy_from_obs(AVBufferRef* frames, uint32_t handle, uint64_t lock_key,
+			                           uint64_t* next_lock_key, std::shared_ptr<AVFrame> frame) override;
+
+			virtual std::shared_ptr<AVFrame> avframe_from_obs(AVBufferRef* frames, uint32_t handle,
+			                                                  uint64_t  lock_key,
+			                                                  uint64_t* next_lock_key) override;
+		};
+	} // namespace hwapi
+} // namespace obsffmpeg
@@ -0,0 +1,56 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cinttypes>
+
+namespace obsffmpeg {
+	namespace ipc {
+		// Messages between the plugin and the encoder host. Every record in a ring starts with a header, the
+		// rest of the record depends on the type.
+		enum class message_type : uint32_t {
+			CONFIGURE, // Plugin to host: 'key=value' lines describing the context, see remote_encoder.
+			FRAME,     // Plugin to host: one frame, 'planes' times plane_header followed by its rows.
+			FLUSH,     // Plugin to host: no more frames will follow.
+			OPENED,    // Host to plugin: the context is open, the payload is its extradata.
+			PACKET,    // Host to plugin: one packet, the payload is its data.
+			FLUSHED,   // Host to plugin: every packet was delivered.
+			FAILED,    // Host to plugin: the payload is an error message, the host exits afterwards.
+		};
+
+		// Set in message_header::flags of a frame that must become a keyframe.
+		static constexpr int32_t FRAME_FLAG_KEY = 1;
+
+		struct message_header {
+			message_type type;
+			int32_t      flags;
+			int64_t      pts;
+			int64_t      dts;
+			uint32_t     planes;
+			uint32_t     reserved;
+		};
+
+		struct plane_header {
+			int32_t linesize;
+			int32_t height;
+		};
+	} // namespace ipc
+} // namespace obsffmpeg
@@ -0,0 +1,224 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "shm_ring.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+extern "C" {
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+// Records start with their size and are padded to keep the next size aligned.
+#define RECORD_ALIGN 8
+
+static size_t align_record(size_t size)
+{
+	return (size + (RECORD_ALIGN - 1)) & ~static_cast<size_t>(RECORD_ALIGN - 1);
+}
+
+// Shared futexes, the word lives in memory mapped by more than one process.
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t value, std::chrono::milliseconds timeout)
+{
+	timespec ts;
+	ts.tv_sec  = static_cast<time_t>(timeout.count() / 1000);
+	ts.tv_nsec = static_cast<long>((timeout.count() % 1000) * 1000000);
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value, &ts, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+obsffmpeg::ipc::shm_ring::shm_ring(int fd, size_t size, bool initialize)
+    : _fd(fd), _size(size), _capacity(size - align_record(sizeof(header)))
+{
+	if (_size <= align_record(sizeof(header))) {
+		::close(_fd);
+		throw std::runtime_error("Shared ring is too small.");
+	}
+
+	void* ptr = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (ptr == MAP_FAILED) {
+		::close(_fd);
+		throw std::runtime_error("Failed to map shared ring.");
+	}
+	_header = reinterpret_cast<header*>(ptr);
+	_data   = reinterpret_cast<uint8_t*>(ptr) + align_record(sizeof(header));
+
+	if (initialize) {
+		new (_header) header();
+		_header->capacity = _capacity;
+	} else if (_header->capacity != _capacity) {
+		munmap(ptr, _size);
+		::close(_fd);
+		throw std::runtime_error("Shared ring has an unexpected size.");
+	}
+}
+
+obsffmpeg::ipc::shm_ring::~shm_ring()
+{
+	munmap(_header, _size);
+	::close(_fd);
+}
+
+std::shared_ptr<obsffmpeg::ipc::shm_ring> obsffmpeg::ipc::shm_ring::create(const char* name, size_t capacity)
+{
+	int fd = static_cast<int>(syscall(SYS_memfd_create, name, MFD_CLOEXEC));
+	if (fd < 0)
+		throw std::runtime_error("Failed to create shared memory file.");
+
+	size_t size = align_record(sizeof(header)) + align_record(capacity);
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		::close(fd);
+		throw std::runtime_error("Failed to size shared memory file.");
+	}
+	return std::shared_ptr<shm_ring>(new shm_ring(fd, size, true));
+}
+
+std::shared_ptr<obsffmpeg::ipc::shm_ring> obsffmpeg::ipc::shm_ring::attach(int fd)
+{
+	off_t size = lseek(fd, 0, SEEK_END);
+	if (size <= 0) {
+		::close(fd);
+		throw std::runtime_error("Shared memory file is empty.");
+	}
+	return std::shared_ptr<shm_ring>(new shm_ring(fd, static_cast<size_t>(size), false));
+}
+
+int obsffmpeg::ipc::shm_ring::get_fd()
+{
+	return _fd;
+}
+
+void obsffmpeg::ipc::shm_ring::copy_in(uint64_t position, const void* data, size_t size)
+{
+	size_t offset = static_cast<size_t>(position % _capacity);
+	size_t first  = std::min(size, static_cast<size_t>(_capacity) - offset);
+	std::memcpy(_data + offset, data, first);
+	std::memcpy(_data, reinterpret_cast<const uint8_t*>(data) + first, size - first);
+}
+
+void obsffmpeg::ipc::shm_ring::copy_out(uint64_t position, void* data, size_t size)
+{
+	size_t offset = static_cast<size_t>(position % _capacity);
+	size_t first  = std::min(size, static_cast<size_t>(_capacity) - offset);
+	std::memcpy(data, _data + offset, first);
+	std::memcpy(reinterpret_cast<uint8_t*>(data) + first, _data, size - first);
+}
+
+bool obsffmpeg::ipc::shm_ring::write(const iovec* parts, size_t count, std::chrono::milliseconds timeout)
+{
+	uint64_t size = 0;
+	for (size_t idx = 0; idx < count; idx++)
+		size += parts[idx].iov_len;
+	uint64_t total = align_record(sizeof(uint64_t) + size);
+	if (total > _capacity)
+		throw std::invalid_argument("Record is larger than the shared ring.");
+
+	auto end = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		if (is_closed())
+			return false;
+
+		uint32_t seq  = _header->read.load(std::memory_order_acquire);
+		uint64_t head = _header->head.load(std::memory_order_relaxed);
+		uint64_t tail = _header->tail.load(std::memory_order_acquire);
+		if ((head - tail) > _capacity) {
+			close();
+			return false;
+		}
+		if ((_capacity - (head - tail)) >= total) {
+			copy_in(head, &size, sizeof(uint64_t));
+			uint64_t position = head + sizeof(uint64_t);
+			for (size_t idx = 0; idx < count; idx++) {
+				copy_in(position, parts[idx].iov_base, parts[idx].iov_len);
+				position += parts[idx].iov_len;
+			}
+			_header->head.store(head + total, std::memory_order_release);
+			_header->written.fetch_add(1, std::memory_order_release);
+			futex_wake(&_header->written);
+			return true;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			return false;
+		futex_wait(&_header->read, seq, std::chrono::duration_cast<std::chrono::milliseconds>(end - now));
+	}
+}
+
+bool obsffmpeg::ipc::shm_ring::read(std::vector<uint8_t>& buffer, std::chrono::milliseconds timeout)
+{
+	auto end = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		uint32_t seq  = _header->written.load(std::memory_order_acquire);
+		uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+		uint64_t head = _header->head.load(std::memory_order_acquire);
+		if (head != tail) {
+			// Positions and sizes come from the other process, never trust them beyond the ring.
+			uint64_t used = head - tail;
+			uint64_t size = 0;
+			if ((used >= sizeof(uint64_t)) && (used <= _capacity))
+				copy_out(tail, &size, sizeof(uint64_t));
+			if ((used < sizeof(uint64_t)) || (used > _capacity) || (size > (used - sizeof(uint64_t)))) {
+				close();
+				return false;
+			}
+			buffer.resize(static_cast<size_t>(size));
+			copy_out(tail + sizeof(uint64_t), buffer.data(), buffer.size());
+			_header->tail.store(tail + align_record(sizeof(uint64_t) + size), std::memory_order_release);
+			_header->read.fetch_add(1, std::memory_order_release);
+			futex_wake(&_header->read);
+			return true;
+		}
+
+		// Records written before the ring was closed are still delivered.
+		if (is_closed())
+			return false;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			return false;
+		futex_wait(&_header->written, seq, std::chrono::duration_cast<std::chrono::milliseconds>(end - now));
+	}
+}
+
+void obsffmpeg::ipc::shm_ring::close()
+{
+	_header->closed.store(1, std::memory_order_release);
+	_header->written.fetch_add(1, std::memory_order_release);
+	_header->read.fetch_add(1, std::memory_order_release);
+	futex_wake(&_header->written);
+	futex_wake(&_header->read);
+}
+
+bool obsffmpeg::ipc::shm_ring::is_closed()
+{
+	return _header->closed.load(std::memory_order_acquire) != 0;
+}
@@ -0,0 +1,82 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <sys/uio.h>
+}
+
+namespace obsffmpeg {
+	namespace ipc {
+		// Single producer, single consumer ring of variable sized records in shared memory. Both sides sleep on
+		// futexes in the shared header, so the ring works across processes without any other channel.
+		class shm_ring {
+			struct header {
+				std::atomic<uint64_t> head;    // Bytes written in total.
+				std::atomic<uint64_t> tail;    // Bytes read in total.
+				std::atomic<uint32_t> written; // Futex, changed after every write.
+				std::atomic<uint32_t> read;    // Futex, changed after every read.
+				std::atomic<uint32_t> closed;
+				uint64_t              capacity;
+			};
+
+			int      _fd;
+			size_t   _size;
+			uint64_t _capacity; // Local copy, the one in the header is writable by the other side.
+			header*  _header;
+			uint8_t* _data;
+
+			shm_ring(int fd, size_t size, bool initialize);
+
+			void copy_in(uint64_t position, const void* data, size_t size);
+			void copy_out(uint64_t position, void* data, size_t size);
+
+			public:
+			~shm_ring();
+
+			// Create a new ring backed by an anonymous memory file.
+			static std::shared_ptr<shm_ring> create(const char* name, size_t capacity);
+
+			// Map a ring created by another process, the descriptor is owned by the ring afterwards.
+			static std::shared_ptr<shm_ring> attach(int fd);
+
+			int get_fd();
+
+			// Write one record made from several parts, waits up to timeout for enough space.
+			bool write(const iovec* parts, size_t count, std::chrono::milliseconds timeout);
+
+			// Read the next record into buffer, waits up to timeout for one to arrive. A record that does
+			// not fit the ring closes it, the other side is then treated as failed.
+			bool read(std::vector<uint8_t>& buffer, std::chrono::milliseconds timeout);
+
+			// Wake up and fail all current and future waits on both sides.
+			void close();
+
+			bool is_closed();
+		};
+	} // namespace ipc
+} // namespace obsffmpeg
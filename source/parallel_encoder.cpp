@@ -0,0 +1,358 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "parallel_encoder.hpp"
+#include <algorithm>
+#include <cstring>
+#include "thread_pool.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/opt.h>
+#pragma warning(pop)
+}
+
+// Frames waiting in front of each context, in addition to the one it encodes.
+#define QUEUE_DEPTH 2
+
+static AVCodecContext* clone_context(const AVCodecContext* context)
+{
+	AVCodecContext* copy = avcodec_alloc_context3(context->codec);
+	if (!copy)
+		return nullptr;
+
+	int res = av_opt_copy(copy, context);
+	if ((res >= 0) && context->priv_data)
+		res = av_opt_copy(copy->priv_data, context->priv_data);
+	if (res < 0) {
+		avcodec_free_context(&copy);
+		return nullptr;
+	}
+
+	copy->width                  = context->width;
+	copy->height                 = context->height;
+	copy->pix_fmt                = context->pix_fmt;
+	copy->time_base              = context->time_base;
+	copy->framerate              = context->framerate;
+	copy->ticks_per_frame        = context->ticks_per_frame;
+	copy->sample_aspect_ratio    = context->sample_aspect_ratio;
+	copy->color_range            = context->color_range;
+	copy->colorspace             = context->colorspace;
+	copy->color_primaries        = context->color_primaries;
+	copy->color_trc              = context->color_trc;
+	copy->chroma_sample_location = context->chroma_sample_location;
+	return copy;
+}
+
+obsffmpeg::parallel_encoder::parallel_encoder(size_t count, size_t segment_length,
+                                              const thread_policy& policy)
+    : _policy(policy), _abort(false), _flushing(false), _segment_length(std::max<size_t>(segment_length, 1)),
+      _primary(nullptr), _template(nullptr), _options(nullptr), _frames_in(0), _segments_in(0), _segments_out(0),
+      _last_dts(AV_NOPTS_VALUE), _dts_offset(0), _segment_begins(true)
+{
+	for (size_t idx = 0; idx < std::max<size_t>(count, 1); idx++) {
+		auto instance      = std::make_unique<worker>();
+		instance->context  = nullptr;
+		instance->error    = 0;
+		instance->finished = false;
+		_workers.push_back(std::move(instance));
+	}
+}
+
+obsffmpeg::parallel_encoder::~parallel_encoder()
+{
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		_abort = true;
+		_wake.notify_all();
+	}
+
+	for (auto& instance : _workers) {
+		if (instance->thread.joinable())
+			instance->thread.join();
+
+		while (instance->frames.size() > 0) {
+			av_frame_free(&instance->frames.front());
+			instance->frames.pop();
+		}
+		while (instance->packets.size() > 0) {
+			av_packet_free(&instance->packets.front());
+			instance->packets.pop();
+		}
+
+		// The original context belongs to the encoder.
+		if (instance->context != _primary)
+			avcodec_free_context(&instance->context);
+	}
+
+	avcodec_free_context(&_template);
+	av_dict_free(&_options);
+}
+
+int obsffmpeg::parallel_encoder::open(AVCodecContext* context, AVDictionary** options)
+{
+	// Share the threads of the original context among all of them.
+	if (context->thread_count > 0)
+		context->thread_count = std::max(1, context->thread_count / static_cast<int>(_workers.size()));
+
+	// Copies have to be made before the original is opened, opening changes some of the fields.
+	_primary = context;
+	if (_segment_length > 1) {
+		// Segment contexts are opened by the workers when their segment begins, except for the first one. It is
+		// opened here and provides the headers, the original is never opened and only describes the stream.
+		_template = clone_context(context);
+		if (!_template)
+			return AVERROR(ENOMEM);
+		av_dict_copy(&_options, *options, 0);
+
+		_workers[0]->context = clone_context(_template);
+		if (!_workers[0]->context)
+			return AVERROR(ENOMEM);
+		int res = avcodec_open2(_workers[0]->context, context->codec, options);
+		if (res < 0)
+			return res;
+		obsffmpeg::thread_pool::install(_workers[0]->context);
+
+		const AVCodecContext* first = _workers[0]->context;
+		if (first->extradata_size > 0) {
+			context->extradata = reinterpret_cast<uint8_t*>(
+			    av_mallocz(static_cast<size_t>(first->extradata_size) + AV_INPUT_BUFFER_PADDING_SIZE));
+			if (!context->extradata)
+				return AVERROR(ENOMEM);
+			memcpy(context->extradata, first->extradata, static_cast<size_t>(first->extradata_size));
+			context->extradata_size = first->extradata_size;
+		}
+	} else {
+		_workers[0]->context = context;
+		for (size_t idx = 1; idx < _workers.size(); idx++) {
+			_workers[idx]->context = clone_context(context);
+			if (!_workers[idx]->context)
+				return AVERROR(ENOMEM);
+
+			AVDictionary* copy_options = nullptr;
+			av_dict_copy(&copy_options, *options, 0);
+			int res = avcodec_open2(_workers[idx]->context, context->codec, &copy_options);
+			av_dict_free(&copy_options);
+			if (res < 0)
+				return res;
+			obsffmpeg::thread_pool::install(_workers[idx]->context);
+		}
+
+		// The original encodes as well, and provides the headers.
+		int res = avcodec_open2(context, context->codec, options);
+		if (res < 0)
+			return res;
+		obsffmpeg::thread_pool::install(context);
+	}
+
+	for (auto& instance : _workers) {
+		worker* ptr      = instance.get();
+		instance->thread = std::thread([this, ptr]() { run(ptr); });
+	}
+	return 0;
+}
+
+int obsffmpeg::parallel_encoder::send_frame(const AVFrame* frame)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	if (!frame) {
+		if (_segment_length > 1) {
+			if ((_frames_in % _segment_length) != 0)
+				_workers[(_segments_in - 1) % _workers.size()]->frames.push(nullptr);
+		} else {
+			for (auto& instance : _workers) {
+				instance->frames.push(nullptr);
+			}
+		}
+		_flushing = true;
+		_wake.notify_all();
+		return 0;
+	}
+
+	bool     begins   = (_frames_in % _segment_length) == 0;
+	uint64_t segment  = begins ? _segments_in : _segments_in - 1;
+	auto&    instance = _workers[segment % _workers.size()];
+	if (instance->error < 0)
+		return instance->error;
+	if (instance->frames.size() >= ((_segment_length > 1) ? _segment_length * 2 : QUEUE_DEPTH))
+		return AVERROR(EAGAIN);
+
+	AVFrame* copy = av_frame_clone(frame);
+	if (!copy)
+		return AVERROR(ENOMEM);
+
+	instance->frames.push(copy);
+	_frames_in++;
+	if (begins)
+		_segments_in++;
+	if ((_segment_length > 1) && ((_frames_in % _segment_length) == 0))
+		instance->frames.push(nullptr);
+	_wake.notify_all();
+	return 0;
+}
+
+int obsffmpeg::parallel_encoder::receive_packet(AVPacket* packet)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+
+	// Frames are spread in order, so the next packet always comes from the context of the next segment.
+	while (true) {
+		auto& instance = _workers[_segments_out % _workers.size()];
+		if (instance->packets.size() > 0) {
+			AVPacket* next = instance->packets.front();
+			instance->packets.pop();
+			if (!next) {
+				_segments_out++;
+				_segment_begins = true;
+				continue;
+			}
+
+			av_packet_move_ref(packet, next);
+			av_packet_free(&next);
+			break;
+		}
+
+		if (instance->error < 0)
+			return instance->error;
+		if (_flushing && (_segments_out >= _segments_in))
+			return AVERROR_EOF;
+		if (instance->finished || !instance->thread.joinable())
+			return AVERROR_EOF;
+		if (!_flushing)
+			return AVERROR(EAGAIN);
+		_done.wait(lock);
+	}
+
+	// Every segment starts its own decoding timeline. Where one would overlap the previous one, the whole
+	// segment is shifted, both timestamps alike so that DTS never passes PTS. The shift is kept for all later
+	// segments, otherwise their PTS could collide with the shifted ones.
+	if ((_segment_length > 1) && (packet->dts != AV_NOPTS_VALUE)) {
+		if (_segment_begins) {
+			if ((_last_dts != AV_NOPTS_VALUE) && ((packet->dts + _dts_offset) <= _last_dts))
+				_dts_offset = _last_dts + 1 - packet->dts;
+			_segment_begins = false;
+		}
+		packet->dts += _dts_offset;
+		if (packet->pts != AV_NOPTS_VALUE)
+			packet->pts += _dts_offset;
+		_last_dts = packet->dts;
+	}
+	return 0;
+}
+
+size_t obsffmpeg::parallel_encoder::get_count()
+{
+	return _workers.size();
+}
+
+size_t obsffmpeg::parallel_encoder::get_segment_length()
+{
+	return _segment_length;
+}
+
+int obsffmpeg::parallel_encoder::open_segment(AVCodecContext** context)
+{
+	*context = clone_context(_template);
+	if (!*context)
+		return AVERROR(ENOMEM);
+
+	AVDictionary* options = nullptr;
+	av_dict_copy(&options, _options, 0);
+	int res = avcodec_open2(*context, (*context)->codec, &options);
+	av_dict_free(&options);
+	if (res >= 0)
+		obsffmpeg::thread_pool::install(*context);
+	return res;
+}
+
+void obsffmpeg::parallel_encoder::run(worker* instance)
+{
+	// Failures were already reported by the thread that opened the encoder.
+	if (!_policy.is_default())
+		_policy.apply();
+
+	std::vector<AVPacket*>       packets;
+	std::unique_lock<std::mutex> lock(_lock);
+	while (!_abort && (instance->error == 0)) {
+		if (instance->frames.size() == 0) {
+			_wake.wait(lock);
+			continue;
+		}
+		AVFrame* frame = instance->frames.front();
+		instance->frames.pop();
+		lock.unlock();
+
+		int res = 0;
+		if (!instance->context)
+			res = frame ? open_segment(&instance->context) : AVERROR_EOF;
+		if (res >= 0)
+			res = avcodec_send_frame(instance->context, frame);
+		av_frame_free(&frame);
+		while (res >= 0) {
+			AVPacket* packet = av_packet_alloc();
+			if (!packet) {
+				res = AVERROR(ENOMEM);
+				break;
+			}
+			res = avcodec_receive_packet(instance->context, packet);
+			if (res == 0) {
+				packets.push_back(packet);
+			} else {
+				av_packet_free(&packet);
+			}
+		}
+
+		// The template context is only reopened for the next segment.
+		bool ended = (res == AVERROR_EOF);
+		if (ended && (_segment_length > 1))
+			avcodec_free_context(&instance->context);
+
+		lock.lock();
+		if (!ended && (res != AVERROR(EAGAIN)))
+			instance->error = res;
+
+		// Single frames end with their packet, segments only once all of their frames are encoded.
+		if (_segment_length == 1) {
+			for (AVPacket* packet : packets) {
+				instance->packets.push(packet);
+				instance->packets.push(nullptr);
+			}
+			packets.clear();
+		} else if (ended) {
+			for (AVPacket* packet : packets) {
+				instance->packets.push(packet);
+			}
+			instance->packets.push(nullptr);
+			packets.clear();
+		}
+		_done.notify_all();
+
+		if (ended && (_segment_length == 1))
+			break;
+	}
+
+	for (AVPacket* packet : packets) {
+		av_packet_free(&packet);
+	}
+	instance->finished = true;
+	_done.notify_all();
+}
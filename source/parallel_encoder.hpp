@@ -0,0 +1,96 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "thread_policy.hpp"
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	// Encodes consecutive frames on several identical contexts at once. Frames of intra-only encoders don't
+	// depend on each other and are handed out round-robin. Everything else is cut into segments of one closed
+	// GOP each, and every segment is encoded by a fresh context, which adds about one GOP of latency. Packets
+	// come back in input order either way, the calls mirror avcodec_send_frame and avcodec_receive_packet.
+	class parallel_encoder {
+		struct worker {
+			AVCodecContext*       context;
+			std::thread           thread;
+			std::queue<AVFrame*>  frames;  // nullptr ends the segment, or the stream for single frames.
+			std::queue<AVPacket*> packets; // nullptr ends the segment.
+			int                   error;
+			bool                  finished;
+		};
+
+		std::mutex                           _lock;
+		std::condition_variable              _wake;
+		std::condition_variable              _done;
+		std::vector<std::unique_ptr<worker>> _workers;
+		thread_policy                        _policy;
+		bool                                 _abort;
+		bool                                 _flushing;
+
+		// Segments of more than one frame get a fresh copy of the template for each.
+		size_t          _segment_length;
+		AVCodecContext* _primary;
+		AVCodecContext* _template;
+		AVDictionary*   _options;
+
+		uint64_t _frames_in;
+		uint64_t _segments_in;
+		uint64_t _segments_out;
+		int64_t  _last_dts;
+		int64_t  _dts_offset;
+		bool     _segment_begins;
+
+		int  open_segment(AVCodecContext** context);
+		void run(worker* instance);
+
+		public:
+		parallel_encoder(size_t count, size_t segment_length, const thread_policy& policy);
+		~parallel_encoder();
+
+		// Clone the unopened context and open the copies. The original stays owned by the caller and is only
+		// opened for single frames, segments copy the headers of the first one into it instead. Unused options
+		// are left in the dictionary like with avcodec_open2.
+		int open(AVCodecContext* context, AVDictionary** options);
+
+		// Queue a frame, or flush with nullptr. Returns AVERROR(EAGAIN) while the next context is busy.
+		int send_frame(const AVFrame* frame);
+
+		int receive_packet(AVPacket* packet);
+
+		size_t get_count();
+
+		size_t get_segment_length();
+	};
+} // namespace obsffmpeg
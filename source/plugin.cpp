@@ -22,7 +22,19 @@
 #include "plugin.hpp"
 #include <map>
 #include <memory>
+#include "audio_batch.hpp"
+#include "benchmark.hpp"
+#include "codec_index.hpp"
+#include "codec_probe.hpp"
+#include "cpu_budget.hpp"
 #include "encoder.hpp"
+#ifdef ENABLE_FAULT_INJECTION
+#include "hwapi/fault.hpp"
+#endif
+#ifdef ENABLE_OUT_OF_PROCESS
+#include "remote_encoder.hpp"
+#endif
+#include "thread_pool.hpp"
 #include "ui/debug_handler.hpp"
 #include "ui/handler.hpp"
 #include "utility.hpp"
@@ -30,6 +42,7 @@
 extern "C" {
 #include <obs-module.h>
 #include <obs.h>
+#include <util/platform.h>
 #pragma warning(push)
 #pragma warning(disable : 4244)
 #include <libavcodec/avcodec.h>
@@ -66,6 +79,69 @@ bool obsffmpeg::has_codec_handler(std::string const codec)
 
 static std::map<const AVCodec*, std::shared_ptr<obsffmpeg::encoder_factory>> generic_factories;
 
+std::shared_ptr<obsffmpeg::encoder_factory> obsffmpeg::find_encoder_factory(const AVCodec* codec)
+{
+	auto found = generic_factories.find(codec);
+	if (found == generic_factories.end())
+		return nullptr;
+	return found->second;
+}
+
+std::shared_ptr<obsffmpeg::encoder_factory> obsffmpeg::find_software_encoder_factory(AVCodecID id)
+{
+	std::shared_ptr<obsffmpeg::encoder_factory> factory;
+	obsffmpeg::codec_index::for_each_encoder([&factory, id](const AVCodec* cdc) {
+		if (factory || (cdc->id != id))
+			return;
+		auto found = generic_factories.find(cdc);
+		if ((found != generic_factories.end()) && !found->second->is_hardware()
+		    && !found->second->is_unavailable())
+			factory = found->second;
+	});
+	return factory;
+}
+
+static std::unique_ptr<obsffmpeg::codec_probe> probe;
+
+// Module Configuration
+static obs_data_t* global_config = nullptr;
+
+obs_data_t* obsffmpeg::get_global_config()
+{
+	return global_config;
+}
+
+static std::string get_config_path(const char* file)
+{
+	char*       path = obs_module_config_path(file);
+	std::string res  = path ? path : "";
+	bfree(path);
+	return res;
+}
+
+static void load_global_config()
+{
+	os_mkdirs(get_config_path("").c_str());
+	std::string path = get_config_path("config.json");
+
+	global_config = obs_data_create_from_json_file_safe(path.c_str(), "bak");
+	if (!global_config)
+		global_config = obs_data_create();
+	obsffmpeg::codec_filter::get_defaults(global_config);
+	obsffmpeg::audio_batch::get_defaults(global_config);
+	obsffmpeg::thread_pool::get_defaults(global_config);
+	obsffmpeg::cpu_budget::get_defaults(global_config);
+#ifdef ENABLE_FAULT_INJECTION
+	obsffmpeg::hwapi::fault_instance::get_defaults(global_config);
+#endif
+#ifdef ENABLE_OUT_OF_PROCESS
+	obsffmpeg::remote_encoder::get_defaults(global_config);
+#endif
+
+	// Write the file back so that all options are visible to the user.
+	obs_data_save_json_safe(global_config, path.c_str(), "tmp", "bak");
+}
+
 #pragma warning(push)
 #pragma warning(disable : 4996) // Handled by software and precompiler branch
 MODULE_EXPORT bool obs_module_load(void)
@@ -82,41 +158,64 @@ try {
 		func();
 	}
 
-	// Register all codecs.
-#if FF_API_NEXT
-	if (avcodec_version() < AV_VERSION_INT(58, 0, 0)) {
-		AVCodec* cdc = nullptr;
-		while ((cdc = av_codec_next(cdc)) != nullptr) {
-			if (!av_codec_is_encoder(cdc))
-				continue;
-
-			if ((cdc->type == AVMediaType::AVMEDIA_TYPE_AUDIO)
-			    || (cdc->type == AVMediaType::AVMEDIA_TYPE_VIDEO)) {
-				auto ptr = std::make_shared<obsffmpeg::encoder_factory>(cdc);
-				ptr->register_encoder();
-				generic_factories.emplace(cdc, ptr);
+	// Load configuration.
+	load_global_config();
+
+	// Load the codec index, or rebuild it if FFmpeg or this plugin changed since the last run.
+	obsffmpeg::codec_index index;
+	std::string            index_path = get_config_path("codec-index.json");
+	{
+		BENCHMARK_SCOPE("module.index", "codec-index.json");
+		if (!index.load(index_path)) {
+			PLOG_INFO("Rebuilding codec index for FFmpeg build %s.", index.get_current_version().c_str());
+			index.rebuild();
+			if (!index.save(index_path)) {
+				PLOG_WARNING("Failed to save codec index to '%s'.", index_path.c_str());
 			}
+		} else {
+			index.resolve();
 		}
-	} else {
-#endif
-#if LIBAVCODEC_VERSION_MAJOR >= 58
-		void*          storage = nullptr;
-		const AVCodec* cdc     = nullptr;
-		for (cdc = av_codec_iterate(&storage); cdc != nullptr; cdc = av_codec_iterate(&storage)) {
-			if (!av_codec_is_encoder(cdc))
-				continue;
-
-			if (/*(cdc->type == AVMediaType::AVMEDIA_TYPE_AUDIO)
-			    || */(cdc->type == AVMediaType::AVMEDIA_TYPE_VIDEO)) {
-				auto ptr = std::make_shared<obsffmpeg::encoder_factory>(cdc);
-				ptr->register_encoder();
-				generic_factories.emplace(cdc, ptr);
-			}
+	}
+
+	// Register all allowed codecs.
+	obsffmpeg::codec_filter filter(global_config);
+	for (auto& entry : index.get_entries()) {
+		if ((entry.type != AVMediaType::AVMEDIA_TYPE_VIDEO) && (entry.type != AVMediaType::AVMEDIA_TYPE_AUDIO))
+			continue;
+
+		if (!filter.is_allowed(entry))
+			continue;
+
+		const AVCodec* cdc = entry.codec;
+		if (!cdc)
+			continue;
+
+		std::shared_ptr<obsffmpeg::encoder_factory> ptr;
+		{
+			BENCHMARK_SCOPE("module.factory", cdc->name);
+			ptr = std::make_shared<obsffmpeg::encoder_factory>(entry);
 		}
-#endif
-#if FF_API_NEXT
+		if (entry.probed && !entry.available) {
+			PLOG_INFO("<%s> Failed to open during probing, flagging as unavailable.", cdc->name);
+			ptr->mark_unavailable();
+		}
+		{
+			BENCHMARK_SCOPE("module.register", cdc->name);
+			ptr->register_encoder();
+		}
+		generic_factories.emplace(cdc, ptr);
 	}
-#endif
+
+	// Probe encoders which have no cached results in the background.
+	bool need_probe = false;
+	for (auto& entry : index.get_entries()) {
+		need_probe |= obsffmpeg::codec_probe::should_probe(entry) && filter.is_allowed(entry);
+	}
+	if (need_probe) {
+		probe = std::make_unique<obsffmpeg::codec_probe>(index, filter, index_path);
+	}
+
+	BENCHMARK_REPORT("module.");
 
 	return true;
 } catch (std::exception& ex) {
@@ -130,10 +229,18 @@ try {
 
 MODULE_EXPORT void obs_module_unload(void)
 try {
+	// Wait for the probe to finish.
+	probe.reset();
+
 	// Run all finalizers.
 	for (auto const func : obsffmpeg::finalizers) {
 		func();
 	}
+
+	if (global_config) {
+		obs_data_release(global_config);
+		global_config = nullptr;
+	}
 } catch (std::exception& ex) {
 	PLOG_ERROR("Exception during finalizing: %s.", ex.what());
 } catch (...) {
@@ -27,6 +27,8 @@
 #include "ui/handler.hpp"
 
 namespace obsffmpeg {
+	class encoder_factory;
+
 	extern std::list<std::function<void()>> initializers;
 
 	extern std::list<std::function<void()>> finalizers;
@@ -37,6 +39,14 @@ namespace obsffmpeg {
 
 	bool has_codec_handler(std::string codec);
 
+	std::shared_ptr<obsffmpeg::encoder_factory> find_encoder_factory(const AVCodec* codec);
+
+	// The registered software encoder FFmpeg prefers for a codec, for hardware encoders to fail over to.
+	std::shared_ptr<obsffmpeg::encoder_factory> find_software_encoder_factory(AVCodecID id);
+
+	// Module-wide configuration, loaded from the module config directory.
+	obs_data_t* get_global_config();
+
 } // namespace obsffmpeg
 
 MODULE_EXPORT bool obs_module_load(void);
@@ -0,0 +1,83 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "realtime_policy.hpp"
+
+// Seconds between two reports of dropped frames.
+#define REPORT_INTERVAL 10
+
+obsffmpeg::realtime_policy::realtime_policy()
+    : _interval(0), _anchored(false), _anchor_pts(0), _dropped(0), _dropped_reported(0),
+      _report_time(std::chrono::high_resolution_clock::now())
+{}
+
+void obsffmpeg::realtime_policy::set_interval(double_t seconds)
+{
+	_interval = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double_t>(seconds));
+	_anchored = false;
+}
+
+bool obsffmpeg::realtime_policy::should_drop(int64_t pts, bool keyframe)
+{
+	auto now = std::chrono::high_resolution_clock::now();
+
+	// Anchor on the earliest arrival seen, so that the lateness is measured against the best case and not
+	// against a frame that was already late.
+	if (!_anchored || ((_anchor_time + (pts - _anchor_pts) * _interval) > now)) {
+		_anchor_time = now;
+		_anchor_pts  = pts;
+		_anchored    = true;
+		return false;
+	}
+
+	// Frames that place a keyframe are what decoders resynchronize on, they are always encoded. All others are
+	// given up once the frame arrives later than one full interval, which is when the next one is already due.
+	if (keyframe)
+		return false;
+	return (now - (_anchor_time + (pts - _anchor_pts) * _interval)) > _interval;
+}
+
+std::chrono::high_resolution_clock::time_point obsffmpeg::realtime_policy::get_deadline(int64_t pts)
+{
+	return _anchor_time + (pts - _anchor_pts + 1) * _interval;
+}
+
+void obsffmpeg::realtime_policy::count_drop()
+{
+	_dropped++;
+}
+
+uint64_t obsffmpeg::realtime_policy::get_dropped()
+{
+	return _dropped;
+}
+
+bool obsffmpeg::realtime_policy::should_report(uint64_t& dropped)
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	if ((_dropped == _dropped_reported) || ((now - _report_time) < std::chrono::seconds(REPORT_INTERVAL)))
+		return false;
+
+	dropped           = _dropped - _dropped_reported;
+	_dropped_reported = _dropped;
+	_report_time      = now;
+	return true;
+}
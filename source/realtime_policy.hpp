@@ -0,0 +1,59 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+
+namespace obsffmpeg {
+	// Decides which frames to give up on when the encoder falls behind real time. Each frame is due at the
+	// time its timestamp says, and has until the next frame is due to be handed to the encoder.
+	class realtime_policy {
+		std::chrono::nanoseconds                       _interval;
+		bool                                           _anchored;
+		std::chrono::high_resolution_clock::time_point _anchor_time;
+		int64_t                                        _anchor_pts;
+
+		uint64_t                                       _dropped;
+		uint64_t                                       _dropped_reported;
+		std::chrono::high_resolution_clock::time_point _report_time;
+
+		public:
+		realtime_policy();
+
+		// Length of one timestamp unit, usually one frame.
+		void set_interval(double_t seconds);
+
+		// Returns true if a frame that arrives now should not be encoded at all.
+		bool should_drop(int64_t pts, bool keyframe);
+
+		// Latest point in time at which the frame may still be handed to the encoder.
+		std::chrono::high_resolution_clock::time_point get_deadline(int64_t pts);
+
+		void count_drop();
+
+		uint64_t get_dropped();
+
+		// Returns true and the number of frames dropped since the last report, at most once every few seconds.
+		bool should_report(uint64_t& dropped);
+	};
+} // namespace obsffmpeg
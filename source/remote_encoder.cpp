@@ -0,0 +1,381 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "remote_encoder.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "ipc/protocol.hpp"
+#include "utility.hpp"
+
+extern "C" {
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#pragma warning(pop)
+}
+
+extern char** environ;
+
+#define ST_CONFIG_NICE "OutOfProcess.Nice"
+#define ST_CONFIG_AFFINITY "OutOfProcess.Affinity"
+
+// Room for this many frames in the frame ring, more only adds latency.
+#define FRAME_RING_FRAMES 4
+#define PACKET_RING_SIZE (16 * 1024 * 1024)
+
+static const std::chrono::milliseconds POLL_INTERVAL = std::chrono::milliseconds(100);
+static const std::chrono::seconds      OPEN_TIMEOUT  = std::chrono::seconds(30);
+static const std::chrono::seconds      FLUSH_TIMEOUT = std::chrono::seconds(5);
+
+using namespace obsffmpeg::ipc;
+
+static std::string get_host_path()
+{
+	Dl_info info = {};
+	if ((dladdr(reinterpret_cast<void*>(&get_host_path), &info) == 0) || !info.dli_fname)
+		throw std::runtime_error("Unable to locate the plugin module.");
+
+	std::string path  = info.dli_fname;
+	size_t      split = path.find_last_of('/');
+	path              = (split != std::string::npos) ? path.substr(0, split + 1) : std::string("./");
+	return path + PROJECT_NAME "-host";
+}
+
+// The host asks to be killed when its parent goes away, which Linux ties to the thread that spawned it rather than to
+// the process. Encoders are created on whatever thread OBS or the background open uses, so all hosts are spawned from
+// this one thread instead, which lives as long as the plugin.
+class host_spawner {
+	std::mutex                        _lock;
+	std::condition_variable           _wake;
+	std::queue<std::function<void()>> _tasks;
+	bool                              _stop;
+	std::thread                       _worker;
+
+	void worker()
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		while (!_stop) {
+			if (_tasks.empty()) {
+				_wake.wait(lock);
+				continue;
+			}
+
+			auto task = std::move(_tasks.front());
+			_tasks.pop();
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+
+	public:
+	host_spawner() : _stop(false)
+	{
+		_worker = std::thread(&host_spawner::worker, this);
+	}
+
+	~host_spawner()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_stop = true;
+			_wake.notify_all();
+		}
+		_worker.join();
+	}
+
+	int spawn(pid_t* pid, const char* path, const posix_spawn_file_actions_t* actions, char* const* args)
+	{
+		std::packaged_task<int()> task(
+		    [&]() { return posix_spawn(pid, path, actions, nullptr, args, environ); });
+		std::future<int> result = task.get_future();
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_tasks.push([&task]() { task(); });
+			_wake.notify_all();
+		}
+		return result.get();
+	}
+
+	static host_spawner& get()
+	{
+		static host_spawner instance;
+		return instance;
+	}
+};
+
+static std::string serialize_options(void* obj)
+{
+	char*       buffer = nullptr;
+	std::string res;
+	if (obj && (av_opt_serialize(obj, 0, AV_OPT_SERIALIZE_SKIP_DEFAULTS, &buffer, '=', ':') >= 0) && buffer)
+		res = buffer;
+	av_free(buffer);
+	return res;
+}
+
+obsffmpeg::remote_encoder::remote_encoder(size_t frame_size, obs_data_t* config, const thread_policy& policy)
+    : _pid(0), _flushing(false), _eof(false)
+{
+	_frames  = ipc::shm_ring::create(PROJECT_NAME "-frames", (frame_size + 4096) * FRAME_RING_FRAMES);
+	_packets = ipc::shm_ring::create(PROJECT_NAME "-packets", PACKET_RING_SIZE);
+
+	// The policy of the encoder takes precedence over the global one.
+	thread_policy host_policy = policy;
+	if (host_policy.is_default() && config) {
+		host_policy.nice = static_cast<int>(obs_data_get_int(config, ST_CONFIG_NICE));
+		host_policy.cpus = obs_data_get_string(config, ST_CONFIG_AFFINITY);
+	}
+
+	std::string path       = get_host_path();
+	std::string nice_value = std::to_string(host_policy.nice);
+
+	std::vector<char*> args;
+	args.push_back(const_cast<char*>(path.c_str()));
+	args.push_back(const_cast<char*>("--nice"));
+	args.push_back(const_cast<char*>(nice_value.c_str()));
+	if (host_policy.cpus.length() > 0) {
+		args.push_back(const_cast<char*>("--cpus"));
+		args.push_back(const_cast<char*>(host_policy.cpus.c_str()));
+	}
+	if (host_policy.batch)
+		args.push_back(const_cast<char*>("--batch"));
+	args.push_back(nullptr);
+
+	// Move the descriptors out of the way of 3 and 4 first, so that neither dup2 overwrites the other.
+	int frames_fd  = fcntl(_frames->get_fd(), F_DUPFD_CLOEXEC, 5);
+	int packets_fd = fcntl(_packets->get_fd(), F_DUPFD_CLOEXEC, 5);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, frames_fd, 3);
+	posix_spawn_file_actions_adddup2(&actions, packets_fd, 4);
+	int res = ((frames_fd < 0) || (packets_fd < 0))
+	              ? EBADF
+	              : host_spawner::get().spawn(&_pid, path.c_str(), &actions, args.data());
+	posix_spawn_file_actions_destroy(&actions);
+	if (frames_fd >= 0)
+		::close(frames_fd);
+	if (packets_fd >= 0)
+		::close(packets_fd);
+
+	if (res != 0) {
+		_pid = 0;
+		std::stringstream sstr;
+		sstr << "Failed to start encoder host '" << path << "': " << strerror(res);
+		throw std::runtime_error(sstr.str());
+	}
+	PLOG_DEBUG("Started encoder host %d with %zu bytes per frame.", static_cast<int>(_pid), frame_size);
+}
+
+obsffmpeg::remote_encoder::~remote_encoder()
+{
+	_frames->close();
+	_packets->close();
+	if (_pid == 0)
+		return;
+
+	// Give the host a moment to exit on its own, it might still be inside the encoder.
+	auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (is_alive() && (std::chrono::steady_clock::now() < give_up)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (is_alive()) {
+		PLOG_WARNING("Encoder host %d did not exit, killing it.", static_cast<int>(_pid));
+		kill(_pid, SIGKILL);
+		waitpid(_pid, nullptr, 0);
+	}
+}
+
+void obsffmpeg::remote_encoder::get_defaults(obs_data_t* config)
+{
+	obs_data_set_default_int(config, ST_CONFIG_NICE, 0);
+	obs_data_set_default_string(config, ST_CONFIG_AFFINITY, "");
+}
+
+bool obsffmpeg::remote_encoder::is_alive()
+{
+	if (_pid == 0)
+		return false;
+
+	int status = 0;
+	if (waitpid(_pid, &status, WNOHANG) == 0)
+		return true;
+
+	_pid = 0;
+	return false;
+}
+
+int obsffmpeg::remote_encoder::open(AVCodecContext* context, AVDictionary** options)
+{
+	std::stringstream config;
+	{
+		char* buffer = nullptr;
+		av_dict_get_string(*options, &buffer, '=', ':');
+		config << "codec=" << context->codec->name << '\n'
+		       << "context=" << serialize_options(context) << '\n'
+		       << "private=" << serialize_options(context->priv_data) << '\n'
+		       << "options=" << (buffer ? buffer : "") << '\n'
+		       << "width=" << context->width << '\n'
+		       << "height=" << context->height << '\n'
+		       << "pix_fmt=" << av_get_pix_fmt_name(context->pix_fmt) << '\n'
+		       << "color_range=" << context->color_range << '\n'
+		       << "colorspace=" << context->colorspace << '\n'
+		       << "color_primaries=" << context->color_primaries << '\n'
+		       << "color_trc=" << context->color_trc << '\n'
+		       << "chroma_location=" << context->chroma_sample_location << '\n'
+		       << "ticks_per_frame=" << context->ticks_per_frame << '\n'
+		       << "time_base=" << context->time_base.num << '/' << context->time_base.den << '\n'
+		       << "framerate=" << context->framerate.num << '/' << context->framerate.den << '\n'
+		       << "sar=" << context->sample_aspect_ratio.num << '/' << context->sample_aspect_ratio.den
+		       << '\n';
+		av_free(buffer);
+		av_dict_free(options);
+	}
+
+	std::string    text     = config.str();
+	message_header header   = {message_type::CONFIGURE, 0, 0, 0, 0, 0};
+	iovec          parts[2] = {{&header, sizeof(header)}, {const_cast<char*>(text.data()), text.size()}};
+	if (!_frames->write(parts, 2, POLL_INTERVAL)) {
+		PLOG_ERROR("Failed to configure encoder host.");
+		return AVERROR_EXTERNAL;
+	}
+
+	auto give_up = std::chrono::steady_clock::now() + OPEN_TIMEOUT;
+	while (!_packets->read(_buffer, POLL_INTERVAL) || (_buffer.size() < sizeof(message_header))) {
+		if (!is_alive() || _packets->is_closed() || (std::chrono::steady_clock::now() > give_up)) {
+			PLOG_ERROR("Encoder host did not open the encoder.");
+			return AVERROR_EXTERNAL;
+		}
+	}
+
+	const message_header* reply = reinterpret_cast<const message_header*>(_buffer.data());
+	const uint8_t*        data  = _buffer.data() + sizeof(message_header);
+	size_t                size  = _buffer.size() - sizeof(message_header);
+	if (reply->type != message_type::OPENED) {
+		PLOG_ERROR("Encoder host failed: %.*s", static_cast<int>(size), reinterpret_cast<const char*>(data));
+		return AVERROR_EXTERNAL;
+	}
+
+	av_freep(&context->extradata);
+	context->extradata_size = 0;
+	if (size > 0) {
+		context->extradata = reinterpret_cast<uint8_t*>(av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE));
+		if (!context->extradata)
+			return AVERROR(ENOMEM);
+		memcpy(context->extradata, data, size);
+		context->extradata_size = static_cast<int>(size);
+	}
+	return 0;
+}
+
+int obsffmpeg::remote_encoder::send_frame(const AVFrame* frame)
+{
+	if (!frame) {
+		message_header header   = {message_type::FLUSH, 0, 0, 0, 0, 0};
+		iovec          parts[1] = {{&header, sizeof(header)}};
+		if (!_frames->write(parts, 1, FLUSH_TIMEOUT))
+			return AVERROR_EXTERNAL;
+		_flushing = true;
+		return 0;
+	}
+
+	const AVPixFmtDescriptor* desc   = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+	int                       planes = av_pix_fmt_count_planes(static_cast<AVPixelFormat>(frame->format));
+	if (!desc || (planes <= 0) || (planes > AV_NUM_DATA_POINTERS))
+		return AVERROR(EINVAL);
+
+	message_header header = {message_type::FRAME, 0, frame->pts, 0, static_cast<uint32_t>(planes), 0};
+	if (frame->pict_type == AV_PICTURE_TYPE_I)
+		header.flags |= FRAME_FLAG_KEY;
+
+	plane_header info[AV_NUM_DATA_POINTERS];
+	iovec        parts[1 + AV_NUM_DATA_POINTERS * 2];
+	parts[0] = {&header, sizeof(header)};
+	for (int plane = 0; plane < planes; plane++) {
+		bool chroma            = (plane == 1) || (plane == 2);
+		info[plane].linesize   = frame->linesize[plane];
+		info[plane].height     = chroma ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+		size_t size            = static_cast<size_t>(info[plane].linesize) * info[plane].height;
+		parts[1 + plane * 2]     = {&info[plane], sizeof(plane_header)};
+		parts[1 + plane * 2 + 1] = {frame->data[plane], size};
+	}
+
+	// Never block the encode thread, a full ring means the host is behind.
+	if (!_frames->write(parts, 1 + static_cast<size_t>(planes) * 2, std::chrono::milliseconds(0)))
+		return is_alive() ? AVERROR(EAGAIN) : AVERROR_EXTERNAL;
+	return 0;
+}
+
+int obsffmpeg::remote_encoder::receive_packet(AVPacket* packet)
+{
+	if (_eof)
+		return AVERROR_EOF;
+
+	// While flushing there is nothing else to do but wait for the host.
+	auto timeout = _flushing ? std::chrono::duration_cast<std::chrono::milliseconds>(FLUSH_TIMEOUT)
+	                         : std::chrono::milliseconds(0);
+	if (!_packets->read(_buffer, timeout) || (_buffer.size() < sizeof(message_header))) {
+		if (!is_alive() || _flushing || _packets->is_closed()) {
+			PLOG_ERROR("Encoder host stopped unexpectedly.");
+			return AVERROR_EXTERNAL;
+		}
+		return AVERROR(EAGAIN);
+	}
+
+	const message_header* header = reinterpret_cast<const message_header*>(_buffer.data());
+	const uint8_t*        data   = _buffer.data() + sizeof(message_header);
+	size_t                size   = _buffer.size() - sizeof(message_header);
+	switch (header->type) {
+	case message_type::PACKET: {
+		int res = av_new_packet(packet, static_cast<int>(size));
+		if (res < 0)
+			return res;
+		memcpy(packet->data, data, size);
+		packet->pts   = header->pts;
+		packet->dts   = header->dts;
+		packet->flags = header->flags;
+		return 0;
+	}
+	case message_type::FLUSHED:
+		_eof = true;
+		return AVERROR_EOF;
+	case message_type::FAILED:
+		PLOG_ERROR("Encoder host failed: %.*s", static_cast<int>(size), reinterpret_cast<const char*>(data));
+		return AVERROR_EXTERNAL;
+	default:
+		return AVERROR(EAGAIN);
+	}
+}
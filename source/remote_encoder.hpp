@@ -0,0 +1,67 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "ipc/shm_ring.hpp"
+#include "thread_policy.hpp"
+
+extern "C" {
+#include <obs.h>
+#include <sys/types.h>
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	// Runs an encoder in a separate host process, frames and packets are exchanged through shared memory. The
+	// calls mirror avcodec_send_frame and avcodec_receive_packet, so the encoder can switch between both.
+	class remote_encoder {
+		pid_t                          _pid;
+		std::shared_ptr<ipc::shm_ring> _frames;
+		std::shared_ptr<ipc::shm_ring> _packets;
+		std::vector<uint8_t>           _buffer;
+		bool                           _flushing;
+		bool                           _eof;
+
+		bool is_alive();
+
+		public:
+		remote_encoder(size_t frame_size, obs_data_t* config, const thread_policy& policy);
+		~remote_encoder();
+
+		static void get_defaults(obs_data_t* config);
+
+		// Send the configuration of an unopened context to the host and wait until it opened the encoder.
+		// Consumes the options, and stores the extradata of the remote context in the local one.
+		int open(AVCodecContext* context, AVDictionary** options);
+
+		// Queue a frame, or flush with nullptr. Returns AVERROR(EAGAIN) while the frame ring is full.
+		int send_frame(const AVFrame* frame);
+
+		int receive_packet(AVPacket* packet);
+	};
+} // namespace obsffmpeg
@@ -0,0 +1,128 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "resource_cache.hpp"
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "plugin.hpp"
+#include "utility.hpp"
+
+// Seconds that released resources are kept for, and how many sets are kept at most.
+#define CACHE_LIFETIME 30
+#define CACHE_ENTRIES 4
+
+struct cache_entry {
+	obsffmpeg::resources                           res;
+	std::chrono::high_resolution_clock::time_point released;
+};
+
+static std::mutex                                             cache_lock;
+static std::multimap<obsffmpeg::resource_key, cache_entry> cache;
+
+INITIALIZER(resource_cache_init)
+{
+	obsffmpeg::finalizers.push_back([]() { obsffmpeg::resource_cache::clear(); });
+};
+
+static void free_resources(obsffmpeg::resources& res)
+{
+	if (res.scaler) {
+		sws_freeContext(res.scaler);
+		res.scaler = nullptr;
+	}
+	av_buffer_unref(&res.hw_frames);
+	while (res.frames.size() > 0)
+		res.frames.pop();
+}
+
+// Call with cache_lock held.
+static void expire(std::chrono::high_resolution_clock::time_point now)
+{
+	for (auto it = cache.begin(); it != cache.end();) {
+		if ((now - it->second.released) > std::chrono::seconds(CACHE_LIFETIME)) {
+			free_resources(it->second.res);
+			it = cache.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+bool obsffmpeg::resource_key::operator<(const resource_key& rhs) const
+{
+	return std::tie(device, source_width, source_height, source_format, target_width, target_height,
+	                target_format, colorspace, full_range, flags)
+	       < std::tie(rhs.device, rhs.source_width, rhs.source_height, rhs.source_format, rhs.target_width,
+	                  rhs.target_height, rhs.target_format, rhs.colorspace, rhs.full_range, rhs.flags);
+}
+
+void obsffmpeg::resource_cache::release(const resource_key& key, resources& res)
+{
+	auto now = std::chrono::high_resolution_clock::now();
+
+	std::unique_lock<std::mutex> lock(cache_lock);
+	expire(now);
+
+	// Make room by dropping the oldest set.
+	while (cache.size() >= CACHE_ENTRIES) {
+		auto oldest = cache.begin();
+		for (auto it = cache.begin(); it != cache.end(); it++) {
+			if (it->second.released < oldest->second.released)
+				oldest = it;
+		}
+		free_resources(oldest->second.res);
+		cache.erase(oldest);
+	}
+
+	cache_entry entry;
+	entry.res.scaler    = res.scaler;
+	entry.res.hw_frames = res.hw_frames;
+	entry.res.frames.swap(res.frames);
+	entry.released = now;
+	res.scaler     = nullptr;
+	res.hw_frames  = nullptr;
+	cache.emplace(key, std::move(entry));
+}
+
+bool obsffmpeg::resource_cache::acquire(const resource_key& key, resources& res)
+{
+	std::unique_lock<std::mutex> lock(cache_lock);
+	expire(std::chrono::high_resolution_clock::now());
+
+	auto found = cache.find(key);
+	if (found == cache.end())
+		return false;
+
+	res.scaler    = found->second.res.scaler;
+	res.hw_frames = found->second.res.hw_frames;
+	res.frames.swap(found->second.res.frames);
+	cache.erase(found);
+	return true;
+}
+
+void obsffmpeg::resource_cache::clear()
+{
+	std::unique_lock<std::mutex> lock(cache_lock);
+	for (auto& kv : cache)
+		free_resources(kv.second.res);
+	cache.clear();
+}
@@ -0,0 +1,72 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <stack>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libswscale/swscale.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	// Everything that decides whether a scaler, a frame or a hardware frame pool can be used by another encoder.
+	struct resource_key {
+		const void*   device; // Native graphics device for hardware frames, nullptr otherwise.
+		uint32_t      source_width;
+		uint32_t      source_height;
+		AVPixelFormat source_format;
+		uint32_t      target_width;
+		uint32_t      target_height;
+		AVPixelFormat target_format;
+		AVColorSpace  colorspace;
+		bool          full_range;
+		int           flags;
+
+		bool operator<(const resource_key& rhs) const;
+	};
+
+	struct resources {
+		SwsContext*                          scaler    = nullptr;
+		AVBufferRef*                         hw_frames = nullptr;
+		std::stack<std::shared_ptr<AVFrame>> frames;
+	};
+
+	// Keeps the conversion resources of destroyed encoders around for a short while, so that an encoder that is
+	// recreated with the same geometry (changed settings, restarted output) only has to open a new codec context.
+	namespace resource_cache {
+		// Takes ownership of the resources.
+		void release(const resource_key& key, resources& res);
+
+		// Returns true and hands over ownership if matching resources were cached.
+		bool acquire(const resource_key& key, resources& res);
+
+		void clear();
+	} // namespace resource_cache
+} // namespace obsffmpeg
@@ -51,3 +51,4 @@
 #define S_KEYFRAMES_INTERVAL "KeyFrames.Interval"
 #define S_KEYFRAMES_INTERVAL_SECONDS "KeyFrames.Interval.Seconds"
 #define S_KEYFRAMES_INTERVAL_FRAMES "KeyFrames.Interval.Frames"
+#define S_KEYFRAMES_INTRAREFRESH "KeyFrames.IntraRefresh"
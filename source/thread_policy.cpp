@@ -0,0 +1,122 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "thread_policy.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+extern "C" {
+#include <windows.h>
+}
+#else
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+#endif
+
+static bool parse_cpus(const std::string& text, std::vector<int>& cpus)
+{
+	std::stringstream stream(text);
+	std::string       item;
+	while (std::getline(stream, item, ',')) {
+		int first = 0, last = 0;
+		int count = sscanf(item.c_str(), "%d-%d", &first, &last);
+		if (count < 1)
+			return false;
+		if (count == 1)
+			last = first;
+		for (int cpu = std::max(first, 0); cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus.size() > 0;
+}
+
+obsffmpeg::thread_policy::thread_policy() : nice(0), batch(false) {}
+
+bool obsffmpeg::thread_policy::is_default() const
+{
+	return (cpus.length() == 0) && (nice == 0) && !batch;
+}
+
+bool obsffmpeg::thread_policy::apply() const
+{
+	bool             success = true;
+	std::vector<int> list;
+	if ((cpus.length() > 0) && !parse_cpus(cpus, list))
+		success = false;
+
+#ifdef _WIN32
+	if (list.size() > 0) {
+		DWORD_PTR mask = 0;
+		for (int cpu : list) {
+			if (cpu < static_cast<int>(sizeof(mask) * 8))
+				mask |= static_cast<DWORD_PTR>(1) << cpu;
+		}
+		success &= (mask != 0) && (SetThreadAffinityMask(GetCurrentThread(), mask) != 0);
+	}
+	if (nice != 0) {
+		int priority = THREAD_PRIORITY_NORMAL;
+		if (nice >= 10) {
+			priority = THREAD_PRIORITY_LOWEST;
+		} else if (nice > 0) {
+			priority = THREAD_PRIORITY_BELOW_NORMAL;
+		} else if (nice <= -10) {
+			priority = THREAD_PRIORITY_HIGHEST;
+		} else {
+			priority = THREAD_PRIORITY_ABOVE_NORMAL;
+		}
+		success &= (SetThreadPriority(GetCurrentThread(), priority) != 0);
+	}
+#else
+#ifdef __linux__
+	if (list.size() > 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : list) {
+			if (cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		}
+		success &= (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+	}
+	if (batch) {
+		sched_param param = {};
+		success &= (pthread_setschedparam(pthread_self(), SCHED_BATCH, &param) == 0);
+	}
+	if (nice != 0) {
+		// Niceness is per thread on Linux.
+		id_t thread = static_cast<id_t>(syscall(SYS_gettid));
+		success &= (setpriority(PRIO_PROCESS, thread, getpriority(PRIO_PROCESS, thread) + nice) == 0);
+	}
+#else
+	if (nice != 0)
+		success &= (setpriority(PRIO_PROCESS, 0, getpriority(PRIO_PROCESS, 0) + nice) == 0);
+#endif
+#endif
+	return success;
+}
@@ -0,0 +1,40 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <string>
+
+namespace obsffmpeg {
+	// Affinity and scheduling of the threads that an encoder starts. On Linux, threads that libavcodec and the
+	// encoder libraries start while a context is opened inherit all of it from the opening thread.
+	struct thread_policy {
+		std::string cpus;  // List of cores like '0,2,4-7', empty for all of them.
+		int         nice;  // Added niceness, 0 leaves the priority alone.
+		bool        batch; // SCHED_BATCH, Linux only.
+
+		thread_policy();
+
+		bool is_default() const;
+
+		// Apply to the calling thread, returns false if any part of it could not be applied.
+		bool apply() const;
+	};
+} // namespace obsffmpeg
@@ -0,0 +1,224 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include "cpu_budget.hpp"
+#include "plugin.hpp"
+#include "utility.hpp"
+
+#define ST_CONFIG_ENABLED "ThreadPool.Enabled"
+#define ST_CONFIG_THREADS "ThreadPool.Threads"
+
+static std::mutex                              pool_lock;
+static std::shared_ptr<obsffmpeg::thread_pool> pool;
+
+INITIALIZER(thread_pool_init)
+{
+	obsffmpeg::finalizers.push_back([]() { obsffmpeg::thread_pool::clear(); });
+};
+
+static int pool_execute(AVCodecContext* context, int (*func)(AVCodecContext* c2, void* arg2), void* arg, int* ret,
+                        int count, int size)
+{
+	auto instance = obsffmpeg::thread_pool::get();
+	if (!instance)
+		return avcodec_default_execute(context, func, arg, ret, count, size);
+
+	return instance->execute(
+	    count, context->thread_count,
+	    [context, func, arg, size](int job, int) {
+		    return func(context, reinterpret_cast<uint8_t*>(arg) + static_cast<size_t>(job) * size);
+	    },
+	    ret);
+}
+
+static int pool_execute2(AVCodecContext* context, int (*func)(AVCodecContext* c2, void* arg2, int jobnr, int threadnr),
+                         void* arg, int* ret, int count)
+{
+	auto instance = obsffmpeg::thread_pool::get();
+	if (!instance)
+		return avcodec_default_execute2(context, func, arg, ret, count);
+
+	return instance->execute(
+	    count, context->thread_count,
+	    [context, func, arg](int job, int thread) { return func(context, arg, job, thread); }, ret);
+}
+
+obsffmpeg::thread_pool::thread_pool(size_t threads) : _pending(0), _abort(false), _next_worker(0)
+{
+	for (size_t idx = 0; idx < std::max<size_t>(threads, 1); idx++) {
+		_workers.push_back(std::make_unique<worker>());
+	}
+	for (size_t idx = 0; idx < _workers.size(); idx++) {
+		_workers[idx]->thread = std::thread([this, idx]() { run(idx); });
+	}
+}
+
+obsffmpeg::thread_pool::~thread_pool()
+{
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		_abort = true;
+		_wake.notify_all();
+	}
+	for (auto& instance : _workers) {
+		if (instance->thread.joinable())
+			instance->thread.join();
+	}
+}
+
+void obsffmpeg::thread_pool::get_defaults(obs_data_t* config)
+{
+	obs_data_set_default_bool(config, ST_CONFIG_ENABLED, true);
+	obs_data_set_default_int(config, ST_CONFIG_THREADS, 0);
+}
+
+std::shared_ptr<obsffmpeg::thread_pool> obsffmpeg::thread_pool::get()
+{
+	std::unique_lock<std::mutex> lock(pool_lock);
+	if (!pool) {
+		obs_data_t* config = obsffmpeg::get_global_config();
+		if (!config || !obs_data_get_bool(config, ST_CONFIG_ENABLED))
+			return nullptr;
+
+		// Matches the cores that the encoders split among themselves.
+		int64_t threads = obs_data_get_int(config, ST_CONFIG_THREADS);
+		if (threads <= 0)
+			threads = static_cast<int64_t>(obsffmpeg::cpu_budget::get_cores());
+		pool = std::make_shared<thread_pool>(static_cast<size_t>(threads));
+		PLOG_INFO("Started shared thread pool with %zu threads.", pool->get_size());
+	}
+	return pool;
+}
+
+void obsffmpeg::thread_pool::clear()
+{
+	std::unique_lock<std::mutex> lock(pool_lock);
+	pool.reset();
+}
+
+void obsffmpeg::thread_pool::install(AVCodecContext* context)
+{
+	if (((context->active_thread_type & FF_THREAD_SLICE) == 0) || (context->thread_count <= 1))
+		return;
+	if (!get())
+		return;
+
+	// The threads libavcodec started while opening stay idle from here on.
+	context->execute  = pool_execute;
+	context->execute2 = pool_execute2;
+}
+
+size_t obsffmpeg::thread_pool::get_size()
+{
+	return _workers.size();
+}
+
+int obsffmpeg::thread_pool::execute(int count, int slots, std::function<int(int job, int thread)> run, int* ret)
+{
+	if (count <= 0)
+		return 0;
+
+	auto job   = std::make_shared<batch>();
+	job->run   = std::move(run);
+	job->ret   = ret;
+	job->count = count;
+	job->next  = 0;
+	job->slot  = 1; // The calling thread is always the first.
+	job->done  = 0;
+
+	// Every helper takes one slot, so thread numbers stay below what the codec prepared for.
+	size_t helpers = static_cast<size_t>(std::max(std::min(count, slots) - 1, 0));
+	helpers        = std::min(helpers, _workers.size());
+	for (size_t idx = 0; idx < helpers; idx++) {
+		auto&                        target = _workers[_next_worker.fetch_add(1) % _workers.size()];
+		std::unique_lock<std::mutex> lock(target->lock);
+		target->queue.push_back(job);
+	}
+	if (helpers > 0) {
+		std::unique_lock<std::mutex> lock(_lock);
+		_pending += helpers;
+		_wake.notify_all();
+	}
+
+	work(*job, 0);
+
+	std::unique_lock<std::mutex> lock(job->lock);
+	job->finished.wait(lock, [&job]() { return job->done.load() >= job->count; });
+	return 0;
+}
+
+bool obsffmpeg::thread_pool::take(size_t index, std::shared_ptr<batch>& job)
+{
+	// Own work from the front, stolen work from the back of the other queues.
+	for (size_t offset = 0; offset < _workers.size(); offset++) {
+		auto&                        target = _workers[(index + offset) % _workers.size()];
+		std::unique_lock<std::mutex> lock(target->lock);
+		if (target->queue.size() == 0)
+			continue;
+
+		if (offset == 0) {
+			job = target->queue.front();
+			target->queue.pop_front();
+		} else {
+			job = target->queue.back();
+			target->queue.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+void obsffmpeg::thread_pool::work(batch& job, int slot)
+{
+	for (int index = job.next.fetch_add(1); index < job.count; index = job.next.fetch_add(1)) {
+		int res = job.run(index, slot);
+		if (job.ret)
+			job.ret[index] = res;
+
+		if (job.done.fetch_add(1) + 1 == job.count) {
+			std::unique_lock<std::mutex> lock(job.lock);
+			job.finished.notify_all();
+		}
+	}
+}
+
+void obsffmpeg::thread_pool::run(size_t index)
+{
+	while (true) {
+		// Claim a helper first, it is guaranteed to be in one of the queues already.
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_wake.wait(lock, [this]() { return _abort || (_pending > 0); });
+			if (_abort)
+				break;
+			_pending--;
+		}
+
+		std::shared_ptr<batch> job;
+		if (!take(index, job))
+			continue;
+
+		// Batches that finished before this helper got to them have no jobs left.
+		work(*job, job->slot.fetch_add(1));
+	}
+}
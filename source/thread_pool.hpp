@@ -0,0 +1,92 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <obs.h>
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <libavcodec/avcodec.h>
+#pragma warning(pop)
+}
+
+namespace obsffmpeg {
+	// Process-wide pool that runs the slice jobs of every encoder, installed as AVCodecContext::execute and
+	// execute2 so that concurrent encoders share one bounded set of threads. Each worker has its own queue and
+	// steals from the others once it runs dry, and the thread that submits jobs works on them as well.
+	class thread_pool {
+		struct batch {
+			std::function<int(int job, int thread)> run;
+			int*                                    ret;
+			int                                     count;
+			std::atomic<int>                        next;
+			std::atomic<int>                        slot;
+			std::atomic<int>                        done;
+			std::mutex                              lock;
+			std::condition_variable                 finished;
+		};
+
+		struct worker {
+			std::thread                        thread;
+			std::mutex                         lock;
+			std::deque<std::shared_ptr<batch>> queue;
+		};
+
+		std::vector<std::unique_ptr<worker>> _workers;
+		std::mutex                           _lock;
+		std::condition_variable              _wake;
+		size_t                               _pending;
+		bool                                 _abort;
+		std::atomic<size_t>                  _next_worker;
+
+		bool take(size_t index, std::shared_ptr<batch>& job);
+		void work(batch& job, int slot);
+		void run(size_t index);
+
+		public:
+		thread_pool(size_t threads);
+		~thread_pool();
+
+		static void get_defaults(obs_data_t* config);
+
+		// The shared pool, or nullptr if it is disabled in the global configuration.
+		static std::shared_ptr<thread_pool> get();
+
+		static void clear();
+
+		// Hand the slice jobs of an opened context to the pool, contexts without slice threads are left alone.
+		static void install(AVCodecContext* context);
+
+		size_t get_size();
+
+		// Run count jobs on at most slots threads at once, and wait for all of them to finish.
+		int execute(int count, int slots, std::function<int(int job, int thread)> run, int* ret);
+	};
+} // namespace obsffmpeg
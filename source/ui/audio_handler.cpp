@@ -0,0 +1,99 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2019 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "audio_handler.hpp"
+#include "codecs/audio.hpp"
+#include "ffmpeg/tools.hpp"
+#include "plugin.hpp"
+#include "strings.hpp"
+#include "utility.hpp"
+
+extern "C" {
+#include <obs-module.h>
+}
+
+INITIALIZER(audio_handler_init)
+{
+	obsffmpeg::initializers.push_back([]() {
+		auto ptr = std::make_shared<obsffmpeg::ui::audio_handler>();
+		obsffmpeg::register_codec_handler("aac", ptr);
+		obsffmpeg::register_codec_handler("libopus", ptr);
+		obsffmpeg::register_codec_handler("flac", ptr);
+	});
+};
+
+static bool is_lossless(const AVCodec* codec)
+{
+	const AVCodecDescriptor* desc = avcodec_descriptor_get(codec->id);
+	return desc && ((desc->props & AV_CODEC_PROP_LOSSLESS) != 0) && ((desc->props & AV_CODEC_PROP_LOSSY) == 0);
+}
+
+void obsffmpeg::ui::audio_handler::get_defaults(obs_data_t* settings, const AVCodec* codec, AVCodecContext*, bool)
+{
+	if (is_lossless(codec)) {
+		obs_data_set_default_int(settings, P_AUDIO_COMPRESSIONLEVEL, 5);
+	} else {
+		obs_data_set_default_int(settings, P_AUDIO_BITRATE, 160);
+	}
+}
+
+bool obsffmpeg::ui::audio_handler::has_keyframe_support(obsffmpeg::encoder*)
+{
+	return false;
+}
+
+void obsffmpeg::ui::audio_handler::get_properties(obs_properties_t* props, const AVCodec* codec,
+                                                  AVCodecContext* context, bool)
+{
+	if (!context) {
+		if (is_lossless(codec)) {
+			auto p = obs_properties_add_int_slider(props, P_AUDIO_COMPRESSIONLEVEL,
+			                                       TRANSLATE(P_AUDIO_COMPRESSIONLEVEL), 0, 12, 1);
+			obs_property_set_long_description(p, TRANSLATE(DESC(P_AUDIO_COMPRESSIONLEVEL)));
+		} else {
+			auto p = obs_properties_add_int(props, P_AUDIO_BITRATE, TRANSLATE(P_AUDIO_BITRATE), 6, 1024, 1);
+			obs_property_set_long_description(p, TRANSLATE(DESC(P_AUDIO_BITRATE)));
+			obs_property_int_set_suffix(p, " kbit/s");
+		}
+	} else {
+		obs_property_set_enabled(obs_properties_get(props, P_AUDIO_COMPRESSIONLEVEL), false);
+		obs_property_set_enabled(obs_properties_get(props, P_AUDIO_BITRATE), false);
+	}
+}
+
+void obsffmpeg::ui::audio_handler::update(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context)
+{
+	if (is_lossless(codec)) {
+		context->compression_level = static_cast<int>(obs_data_get_int(settings, P_AUDIO_COMPRESSIONLEVEL));
+	} else {
+		context->bit_rate = obs_data_get_int(settings, P_AUDIO_BITRATE) * 1000;
+	}
+}
+
+void obsffmpeg::ui::audio_handler::log_options(obs_data_t*, const AVCodec* codec, AVCodecContext* context)
+{
+	PLOG_INFO("[%s]   %s:", codec->name, TRANSLATE(P_AUDIO));
+	if (is_lossless(codec)) {
+		PLOG_INFO("[%s]     Compression Level: %i", codec->name, context->compression_level);
+	} else {
+		PLOG_INFO("[%s]     Bitrate: %lli kbit/s", codec->name, context->bit_rate / 1000);
+	}
+}
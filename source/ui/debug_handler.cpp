@@ -20,9 +20,9 @@
 // SOFTWARE.
 
 #include "debug_handler.hpp"
-#include <map>
 #include <string>
-#include <utility>
+#include "encoder.hpp"
+#include "ffmpeg/tools.hpp"
 #include "handler.hpp"
 #include "plugin.hpp"
 #include "utility.hpp"
@@ -37,172 +37,34 @@ extern "C" {
 
 void obsffmpeg::ui::debug_handler::get_defaults(obs_data_t*, const AVCodec*, AVCodecContext*, bool) {}
 
-template<typename T>
-std::string to_string(T value){};
+void obsffmpeg::ui::debug_handler::get_properties(obs_properties_t*, const AVCodec*, AVCodecContext*, bool) {}
 
-template<>
-std::string to_string(int64_t value)
+void obsffmpeg::ui::debug_handler::log_options(obs_data_t*, const AVCodec* codec, AVCodecContext* context)
 {
-	std::vector<char> buf(32);
-	snprintf(buf.data(), buf.size(), "%lld", value);
-	return std::string(buf.data(), buf.data() + buf.size());
-}
-
-template<>
-std::string to_string(uint64_t value)
-{
-	std::vector<char> buf(32);
-	snprintf(buf.data(), buf.size(), "%llu", value);
-	return std::string(buf.data(), buf.data() + buf.size());
-}
-
-template<>
-std::string to_string(double_t value)
-{
-	std::vector<char> buf(32);
-	snprintf(buf.data(), buf.size(), "%f", value);
-	return std::string(buf.data(), buf.data() + buf.size());
-}
-
-void obsffmpeg::ui::debug_handler::get_properties(obs_properties_t*, const AVCodec* codec, AVCodecContext* context,
-                                                  bool)
-{
-	if (context)
-		return;
-
-	AVCodecContext* ctx = avcodec_alloc_context3(codec);
-	if (!ctx->priv_data) {
-		avcodec_free_context(&ctx);
+	auto factory = obsffmpeg::find_encoder_factory(codec);
+	if (!factory)
 		return;
-	}
 
-	PLOG_INFO("Options for '%s':", codec->name);
+	// Only log what differs from the defaults, the full list is available at debug level.
+	const ffmpeg::option_index& index = factory->get_option_index();
+	PLOG_INFO("[%s]   Options:", codec->name);
+	for (auto& kv : index.get_options()) {
+		auto& info = kv.second;
+		if (!info.is_private)
+			continue;
 
-	std::pair<AVOptionType, std::string> opt_type_name[] = {
-	    {AV_OPT_TYPE_FLAGS, "Flags"},
-	    {AV_OPT_TYPE_INT, "Int"},
-	    {AV_OPT_TYPE_INT64, "Int64"},
-	    {AV_OPT_TYPE_DOUBLE, "Double"},
-	    {AV_OPT_TYPE_FLOAT, "Float"},
-	    {AV_OPT_TYPE_STRING, "String"},
-	    {AV_OPT_TYPE_RATIONAL, "Rational"},
-	    {AV_OPT_TYPE_BINARY, "Binary"},
-	    {AV_OPT_TYPE_DICT, "Dictionary"},
-	    {AV_OPT_TYPE_UINT64, "Unsigned Int64"},
-	    {AV_OPT_TYPE_CONST, "Constant"},
-	    {AV_OPT_TYPE_IMAGE_SIZE, "Image Size"},
-	    {AV_OPT_TYPE_PIXEL_FMT, "Pixel Format"},
-	    {AV_OPT_TYPE_SAMPLE_FMT, "Sample Format"},
-	    {AV_OPT_TYPE_VIDEO_RATE, "Video Rate"},
-	    {AV_OPT_TYPE_DURATION, "Duration"},
-	    {AV_OPT_TYPE_COLOR, "Color"},
-	    {AV_OPT_TYPE_CHANNEL_LAYOUT, "Layout"},
-	    {AV_OPT_TYPE_BOOL, "Bool"},
-	};
-	std::map<std::string, AVOptionType> unit_types;
+		if (av_opt_is_set_to_default_by_name(context, info.name.c_str(), AV_OPT_SEARCH_CHILDREN) != 0)
+			continue;
 
-	const AVOption* opt = nullptr;
-	while ((opt = av_opt_next(ctx->priv_data, opt)) != nullptr) {
-		std::string type_name = "";
-		for (auto kv : opt_type_name) {
-			if (opt->type == kv.first) {
-				type_name = kv.second;
-				break;
-			}
+		if (info.constants.size() > 0) {
+			ffmpeg::tools::print_av_option_string(context, info.name.c_str(), "    " + info.name, index);
+			continue;
 		}
 
-		if (opt->type == AV_OPT_TYPE_CONST) {
-			if (opt->unit == nullptr) {
-				PLOG_INFO("  Constant '%s' and help text '%s' with unknown settings.", opt->name,
-				          opt->help);
-			} else {
-				auto unit_type = unit_types.find(opt->unit);
-				if (unit_type == unit_types.end()) {
-					PLOG_INFO("  [%s] Flag '%s' and help text '%s' with value '%lld'.", opt->unit,
-					          opt->name, opt->help, opt->default_val.i64);
-				} else {
-					std::string out;
-					switch (unit_type->second) {
-					case AV_OPT_TYPE_BOOL:
-						out = opt->default_val.i64 ? "true" : "false";
-						break;
-					case AV_OPT_TYPE_INT:
-						out = to_string(opt->default_val.i64);
-						break;
-					case AV_OPT_TYPE_UINT64:
-						out = to_string(static_cast<uint64_t>(opt->default_val.i64));
-						break;
-					case AV_OPT_TYPE_FLAGS:
-						out = to_string(static_cast<uint64_t>(opt->default_val.i64));
-						break;
-					case AV_OPT_TYPE_FLOAT:
-					case AV_OPT_TYPE_DOUBLE:
-						out = to_string(opt->default_val.dbl);
-						break;
-					case AV_OPT_TYPE_STRING:
-						out = opt->default_val.str;
-						break;
-					case AV_OPT_TYPE_BINARY:
-					case AV_OPT_TYPE_IMAGE_SIZE:
-					case AV_OPT_TYPE_PIXEL_FMT:
-					case AV_OPT_TYPE_SAMPLE_FMT:
-					case AV_OPT_TYPE_VIDEO_RATE:
-					case AV_OPT_TYPE_DURATION:
-					case AV_OPT_TYPE_COLOR:
-					case AV_OPT_TYPE_CHANNEL_LAYOUT:
-						break;
-					}
-
-					PLOG_INFO("  [%s] Constant '%s' and help text '%s' with value '%s'.", opt->unit,
-					          opt->name, opt->help, out.c_str());
-				}
-			}
-		} else {
-			if (opt->unit != nullptr) {
-				unit_types.emplace(opt->name, opt->type);
-			}
-
-			std::string minimum = "", maximum = "", out;
-			minimum = to_string(opt->min);
-			maximum = to_string(opt->max);
-			{
-				switch (opt->type) {
-				case AV_OPT_TYPE_BOOL:
-					out = opt->default_val.i64 ? "true" : "false";
-					break;
-				case AV_OPT_TYPE_INT:
-					out = to_string(opt->default_val.i64);
-					break;
-				case AV_OPT_TYPE_UINT64:
-					out = to_string(static_cast<uint64_t>(opt->default_val.i64));
-					break;
-				case AV_OPT_TYPE_FLAGS:
-					out = to_string(static_cast<uint64_t>(opt->default_val.i64));
-					break;
-				case AV_OPT_TYPE_FLOAT:
-				case AV_OPT_TYPE_DOUBLE:
-					out = to_string(opt->default_val.dbl);
-					break;
-				case AV_OPT_TYPE_STRING:
-					out = opt->default_val.str ? opt->default_val.str : "<invalid>";
-					break;
-				case AV_OPT_TYPE_BINARY:
-				case AV_OPT_TYPE_IMAGE_SIZE:
-				case AV_OPT_TYPE_PIXEL_FMT:
-				case AV_OPT_TYPE_SAMPLE_FMT:
-				case AV_OPT_TYPE_VIDEO_RATE:
-				case AV_OPT_TYPE_DURATION:
-				case AV_OPT_TYPE_COLOR:
-				case AV_OPT_TYPE_CHANNEL_LAYOUT:
-					break;
-				}
-			}
-
-			PLOG_INFO(
-			    "  Option '%s'%s%s%s with help '%s' of type '%s' with default value '%s', minimum '%s' and maximum '%s'.",
-			    opt->name, opt->unit ? " with unit (" : "", opt->unit ? opt->unit : "",
-			    opt->unit ? ")" : "", opt->help, type_name.c_str(), out.c_str(), minimum.c_str(),
-			    maximum.c_str());
+		uint8_t* value = nullptr;
+		if (av_opt_get(context, info.name.c_str(), AV_OPT_SEARCH_CHILDREN, &value) == 0) {
+			PLOG_INFO("[%s]     %s: %s", codec->name, info.name.c_str(), reinterpret_cast<char*>(value));
+			av_free(value);
 		}
 	}
 }
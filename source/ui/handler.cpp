@@ -30,7 +30,8 @@ void obsffmpeg::ui::handler::get_defaults(obs_data_t*, const AVCodec*, AVCodecCo
 
 bool obsffmpeg::ui::handler::has_keyframe_support(obsffmpeg::encoder* instance)
 {
-	return (instance->get_avcodec()->capabilities & AV_CODEC_CAP_INTRA_ONLY) == 0;
+	return (instance->get_avcodec()->type == AVMEDIA_TYPE_VIDEO)
+	       && ((instance->get_avcodec()->capabilities & AV_CODEC_CAP_INTRA_ONLY) == 0);
 }
 
 void obsffmpeg::ui::handler::get_properties(obs_properties_t*, const AVCodec*, AVCodecContext*, bool) {}
@@ -39,8 +40,21 @@ void obsffmpeg::ui::handler::update(obs_data_t*, const AVCodec*, AVCodecContext*
 
 void obsffmpeg::ui::handler::override_update(obsffmpeg::encoder*, obs_data_t*) {}
 
+bool obsffmpeg::ui::handler::has_dynamic_bitrate_support(const AVCodec*)
+{
+	return false;
+}
+
+void obsffmpeg::ui::handler::reconfigure(obs_data_t*, const AVCodec*, AVCodecContext*) {}
+
 void obsffmpeg::ui::handler::log_options(obs_data_t*, const AVCodec*, AVCodecContext*) {}
 
 void obsffmpeg::ui::handler::override_colorformat(AVPixelFormat&, obs_data_t*, const AVCodec*, AVCodecContext*) {}
 
+void obsffmpeg::ui::handler::get_packet_room(const AVCodec*, AVCodecContext*, size_t& headroom, size_t& tailroom)
+{
+	headroom = 0;
+	tailroom = 0;
+}
+
 void obsffmpeg::ui::handler::process_avpacket(AVPacket&, const AVCodec*, AVCodecContext*) {}
@@ -61,6 +61,13 @@ namespace obsffmpeg {
 
 			virtual void override_update(obsffmpeg::encoder* instance, obs_data_t* settings);
 
+			// Encoders that pick up rate control changes on an open context, advertised to OBS as
+			// OBS_ENCODER_CAP_DYN_BITRATE.
+			virtual bool has_dynamic_bitrate_support(const AVCodec* codec);
+
+			// Applies the settings that may change while encoding to an open context.
+			virtual void reconfigure(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
+
 			virtual void log_options(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
 
 			public /*instance*/:
@@ -68,6 +75,10 @@ namespace obsffmpeg {
 			virtual void override_colorformat(AVPixelFormat& target_format, obs_data_t* settings,
 			                                  const AVCodec* codec, AVCodecContext* context);
 
+			// Room that process_avpacket may use in front of and behind the packet data without reallocating.
+			virtual void get_packet_room(const AVCodec* codec, AVCodecContext* context, size_t& headroom,
+			                             size_t& tailroom);
+
 			virtual void process_avpacket(AVPacket& packet, const AVCodec* codec, AVCodecContext* context);
 		};
 	} // namespace ui
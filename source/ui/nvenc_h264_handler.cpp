@@ -117,6 +117,16 @@ void obsffmpeg::ui::nvenc_h264_handler::override_update(obsffmpeg::encoder* inst
 	nvenc::override_update(instance, settings);
 }
 
+bool obsffmpeg::ui::nvenc_h264_handler::has_dynamic_bitrate_support(const AVCodec*)
+{
+	return true;
+}
+
+void obsffmpeg::ui::nvenc_h264_handler::reconfigure(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context)
+{
+	nvenc::reconfigure(settings, codec, context);
+}
+
 void obsffmpeg::ui::nvenc_h264_handler::log_options(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context)
 {
 	nvenc::log_options(settings, codec, context);
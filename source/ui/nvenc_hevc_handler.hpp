@@ -51,6 +51,10 @@ namespace obsffmpeg {
 
 			virtual void override_update(obsffmpeg::encoder* instance, obs_data_t* settings);
 
+			virtual bool has_dynamic_bitrate_support(const AVCodec* codec);
+
+			virtual void reconfigure(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
+
 			virtual void log_options(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
 
 			public /*instance*/:
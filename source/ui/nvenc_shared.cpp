@@ -695,25 +695,46 @@ void obsffmpeg::nvenc::update(obs_data_t* settings, const AVCodec* codec, AVCode
 	}
 }
 
+void obsffmpeg::nvenc::reconfigure(obs_data_t* settings, const AVCodec*, AVCodecContext* context)
+{
+	// Constant QP has no bitrate to change.
+	if (context->bit_rate <= 0)
+		return;
+
+	// OBS's dynamic bitrate only knows the "bitrate" mirror written by update, so a target that still matches
+	// the context means the change came from there. Either value is written back to the other, so that the
+	// target always holds the bitrate that was applied last.
+	int64_t current = context->bit_rate / 1000;
+	int64_t target  = obs_data_get_int(settings, ST_RATECONTROL_BITRATE_TARGET);
+	if (target == current) {
+		target = obs_data_get_int(settings, "bitrate");
+		if (target <= 0)
+			return;
+		obs_data_set_int(settings, ST_RATECONTROL_BITRATE_TARGET, target);
+	} else {
+		if (target <= 0)
+			return;
+		obs_data_set_int(settings, "bitrate", target);
+	}
+
+	context->bit_rate = target * 1000;
+	if (context->rc_max_rate > 0) {
+		context->rc_max_rate = std::max<int64_t>(
+		    obs_data_get_int(settings, ST_RATECONTROL_BITRATE_MAXIMUM) * 1000, context->bit_rate);
+	}
+	context->rc_buffer_size = static_cast<int>(obs_data_get_int(settings, S_RATECONTROL_BUFFERSIZE) * 1000);
+}
+
 void obsffmpeg::nvenc::log_options(obs_data_t*, const AVCodec* codec, AVCodecContext* context)
 {
+	auto factory = obsffmpeg::find_encoder_factory(codec);
+	if (!factory)
+		return;
+	const ffmpeg::option_index& options = factory->get_option_index();
+
 	PLOG_INFO("[%s]   Nvidia NVENC:", codec->name);
-	ffmpeg::tools::print_av_option_string(context, "preset", "    Preset", [](int64_t v) {
-		preset      val   = static_cast<preset>(v);
-		std::string name  = "<Unknown>";
-		auto        index = preset_to_opt.find(val);
-		if (index != preset_to_opt.end())
-			name = index->second;
-		return name;
-	});
-	ffmpeg::tools::print_av_option_string(context, "rc", "    Rate Control", [](int64_t v) {
-		ratecontrolmode val   = static_cast<ratecontrolmode>(v);
-		std::string     name  = "<Unknown>";
-		auto            index = ratecontrolmode_to_opt.find(val);
-		if (index != ratecontrolmode_to_opt.end())
-			name = index->second;
-		return name;
-	});
+	ffmpeg::tools::print_av_option_string(context, "preset", "    Preset", options);
+	ffmpeg::tools::print_av_option_string(context, "rc", "    Rate Control", options);
 	ffmpeg::tools::print_av_option_bool(context, "2pass", "      Two Pass");
 	ffmpeg::tools::print_av_option_int(context, "rc-lookahead", "      Look-Ahead", "Frames");
 	ffmpeg::tools::print_av_option_bool(context, "no-scenecut", "      Adaptive I-Frames");
@@ -734,14 +755,7 @@ void obsffmpeg::nvenc::log_options(obs_data_t*, const AVCodec* codec, AVCodecCon
 	ffmpeg::tools::print_av_option_int(context, "init_qpB", "        B-Frame", "");
 
 	ffmpeg::tools::print_av_option_int(context, "max_b_frames", "    B-Frames", "Frames");
-	ffmpeg::tools::print_av_option_string(context, "b_ref_mode", "      Reference Mode", [](int64_t v) {
-		b_ref_mode  val   = static_cast<b_ref_mode>(v);
-		std::string name  = "<Unknown>";
-		auto        index = b_ref_mode_to_opt.find(val);
-		if (index != b_ref_mode_to_opt.end())
-			name = index->second;
-		return name;
-	});
+	ffmpeg::tools::print_av_option_string(context, "b_ref_mode", "      Reference Mode", options);
 
 	PLOG_INFO("[%s]     Adaptive Quantization:", codec->name);
 	if (strcmp(codec->name, "h264_nvenc") == 0) {
@@ -95,6 +95,9 @@ namespace obsffmpeg {
 
 		void update(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
 
+		// NVENC compares the rate control of the context with its own on every frame and reconfigures itself.
+		void reconfigure(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
+
 		void log_options(obs_data_t* settings, const AVCodec* codec, AVCodecContext* context);
 	} // namespace nvenc
 } // namespace obsffmpeg
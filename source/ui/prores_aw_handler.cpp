@@ -20,6 +20,7 @@
 // SOFTWARE.
 
 #include "prores_aw_handler.hpp"
+#include <cstring>
 #include "codecs/prores.hpp"
 #include "ffmpeg/tools.hpp"
 #include "plugin.hpp"
@@ -120,6 +121,13 @@ void obsffmpeg::ui::prores_aw_handler::log_options(obs_data_t* settings, const A
 	});
 }
 
+void obsffmpeg::ui::prores_aw_handler::get_packet_room(const AVCodec*, AVCodecContext*, size_t& headroom,
+                                                       size_t& tailroom)
+{
+	headroom = 0;
+	tailroom = 8;
+}
+
 void obsffmpeg::ui::prores_aw_handler::process_avpacket(AVPacket& packet, const AVCodec*, AVCodecContext*)
 {
 	//FFmpeg Bug:
@@ -129,7 +137,9 @@ void obsffmpeg::ui::prores_aw_handler::process_avpacket(AVPacket& packet, const
 	// should be content + atom, but FFmpeg set it to only be content. This
 	// difference leads to decoders to be off by 8 bytes.
 	//Fix (until FFmpeg stops being broken):
-	// Pad the packet with 8 bytes of 0x00.
+	// Pad the packet with 8 bytes of 0x00. The room for this is reserved by the
+	// encoder, so this never reallocates or copies the packet.
 
-	av_grow_packet(&packet, 8);
+	std::memset(packet.data + packet.size, 0, 8);
+	packet.size += 8;
 }
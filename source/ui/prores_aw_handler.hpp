@@ -49,6 +49,9 @@ namespace obsffmpeg {
 			virtual void log_options(obs_data_t* settings, const AVCodec* codec,
 			                         AVCodecContext* context) override;
 
+			virtual void get_packet_room(const AVCodec* codec, AVCodecContext* context, size_t& headroom,
+			                             size_t& tailroom) override;
+
 			virtual void process_avpacket(AVPacket& packet, const AVCodec* codec,
 			                              AVCodecContext* context) override;
 		};
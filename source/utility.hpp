@@ -89,14 +89,19 @@ namespace obsffmpeg {
 	}
 
 	struct obs_graphics {
-		obs_graphics()
+		obs_graphics(bool enter = true) : _entered(enter)
 		{
-			obs_enter_graphics();
+			if (_entered)
+				obs_enter_graphics();
 		}
 		~obs_graphics()
 		{
-			obs_leave_graphics();
+			if (_entered)
+				obs_leave_graphics();
 		}
+
+		private:
+		bool _entered;
 	};
 
 	obs_property_t* obs_properties_add_tristate(obs_properties_t* props, const char* name, const char* desc);